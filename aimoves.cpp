@@ -197,7 +197,7 @@ void fillMoveArray(move **m, square from, piece p, bitboard dest)
  *           in a bitboard if the knight can not be captured ( its a possible mate ) 
  */
 
-void fillMoveArrayMateTriesKnights (move **m, square from, bitboard dest, sword attacks[COLORS][64], color onMove)
+void fillMoveArrayMateTriesKnights (move **m, square from, bitboard dest, byte attacks[COLORS][64], color onMove)
    {
    square to;
   
@@ -218,7 +218,7 @@ void fillMoveArrayMateTriesKnights (move **m, square from, bitboard dest, sword
  *           in a bitboard if the piece can not be captured ( its a possible mate ) 
  */
 
-void fillMoveArrayMateTriesOthers (move **m, square from, piece p, bitboard dest, sword attacks[COLORS][64], color onMove)
+void fillMoveArrayMateTriesOthers (move **m, square from, piece p, bitboard dest, byte attacks[COLORS][64], color onMove)
    {
    square to;
   
@@ -254,16 +254,27 @@ int boardStruct::aiMoves(move *m)
    square sq;
    piece p;
    bitboard thePieces, dest, dest2, unoccupied, trythose;
+   bitboard toFirst[PIECES][2];
 
    original = m;   
 
    unoccupied = (~(occupied[WHITE] | occupied[BLACK]));
 
+   /* Take a copy of the history squares, with CORES > 1 the main thread
+      may change them while a helper is in here, and both passes below have
+      to see the same squares or moves get lost. */
+
+   for (p = FIRST_PIECE; p <= LAST_PIECE; p = (piece) (p + 1))
+      {
+      toFirst[p][0] = generateToFirst[p][onMove][0].load(std::memory_order_relaxed);
+      toFirst[p][1] = generateToFirst[p][onMove][1].load(std::memory_order_relaxed);
+      }
+
 
    /* Generate bishop/rook/queen moves bitboard by and-ing the attack bitboard
       with the empty squares */
 
-   trythose = generateToFirst[BISHOP][onMove][0] & unoccupied; 
+   trythose = toFirst[BISHOP][0] & unoccupied; 
   
    
    thePieces = pieces[BISHOP] & occupied[onMove];
@@ -275,7 +286,7 @@ int boardStruct::aiMoves(move *m)
       fillMoveArray(&m, sq, BISHOP, dest);
       }
 
-   trythose = generateToFirst[ROOK][onMove][0] & unoccupied;
+   trythose = toFirst[ROOK][0] & unoccupied;
 
    thePieces = pieces[ROOK] & occupied[onMove];
    while (thePieces.hasBits()) 
@@ -286,7 +297,7 @@ int boardStruct::aiMoves(move *m)
       fillMoveArray(&m, sq, ROOK, dest);
       }
 
-   trythose = generateToFirst[QUEEN][onMove][0] & unoccupied;
+   trythose = toFirst[QUEEN][0] & unoccupied;
 
    thePieces = pieces[QUEEN] & occupied[onMove];
    while (thePieces.hasBits()) 
@@ -299,7 +310,7 @@ int boardStruct::aiMoves(move *m)
 
   /* Generate the knight moves bitboard by using the lookup table */
 
-   trythose = generateToFirst[KNIGHT][onMove][0] & unoccupied;
+   trythose = toFirst[KNIGHT][0] & unoccupied;
 
    thePieces = pieces[KNIGHT] & occupied[onMove];
    while (thePieces.hasBits()) 
@@ -319,7 +330,7 @@ int boardStruct::aiMoves(move *m)
      spaces on the 4th rank to get double pawn moves.
   */
 
-   trythose = generateToFirst[PAWN][onMove][0] & unoccupied;
+   trythose = toFirst[PAWN][0] & unoccupied;
 
    if (onMove == WHITE) 
       {
@@ -374,7 +385,7 @@ int boardStruct::aiMoves(move *m)
 
    if (hand[onMove][PAWN]) 
       {
-      trythose = generateToFirst[PAWN][onMove][1] & unoccupied;
+      trythose = toFirst[PAWN][1] & unoccupied;
 	  dest = trythose & ~(FIRST_RANK | EIGHTH_RANK);
       fillMoveArray(&m, IN_HAND, PAWN, dest);
       }
@@ -383,7 +394,7 @@ int boardStruct::aiMoves(move *m)
       {
       if (hand[onMove][p]) 
          {
-		 trythose = generateToFirst[p][onMove][1] & unoccupied;
+		 trythose = toFirst[p][1] & unoccupied;
          fillMoveArray(&m, IN_HAND, p, trythose);
          }
       }
@@ -393,7 +404,7 @@ int boardStruct::aiMoves(move *m)
    /* Generate bishop/rook/queen moves bitboard by and-ing the attack bitboard
       with the empty squares */
 
-   trythose = ~generateToFirst[BISHOP][onMove][0] & unoccupied;
+   trythose = ~toFirst[BISHOP][0] & unoccupied;
   
    thePieces = pieces[BISHOP] & occupied[onMove];
    while (thePieces.hasBits()) 
@@ -404,7 +415,7 @@ int boardStruct::aiMoves(move *m)
       fillMoveArray(&m, sq, BISHOP, dest);
       }
 
-   trythose = ~generateToFirst[ROOK][onMove][0] & unoccupied;
+   trythose = ~toFirst[ROOK][0] & unoccupied;
    
    thePieces = pieces[ROOK] & occupied[onMove];
    while (thePieces.hasBits()) 
@@ -415,7 +426,7 @@ int boardStruct::aiMoves(move *m)
       fillMoveArray(&m, sq, ROOK, dest);
       }
 
-   trythose = ~generateToFirst[QUEEN][onMove][0] & unoccupied;
+   trythose = ~toFirst[QUEEN][0] & unoccupied;
    
    thePieces = pieces[QUEEN] & occupied[onMove];
    while (thePieces.hasBits()) 
@@ -428,7 +439,7 @@ int boardStruct::aiMoves(move *m)
 
   /* Generate the knight moves bitboard by using the lookup table */
 
-   trythose = ~generateToFirst[KNIGHT][onMove][0] & unoccupied;
+   trythose = ~toFirst[KNIGHT][0] & unoccupied;
    
    thePieces = pieces[KNIGHT] & occupied[onMove];
    while (thePieces.hasBits()) 
@@ -448,7 +459,7 @@ int boardStruct::aiMoves(move *m)
      spaces on the 4th rank to get double pawn moves.
 	 */
 
-   trythose = ~generateToFirst[PAWN][onMove][0] & unoccupied;
+   trythose = ~toFirst[PAWN][0] & unoccupied;
 
    if (onMove == WHITE) 
       {
@@ -502,7 +513,7 @@ int boardStruct::aiMoves(move *m)
 
    if (hand[onMove][PAWN]) 
       {
-	  trythose = ~generateToFirst[PAWN][onMove][1] & unoccupied;
+	  trythose = ~toFirst[PAWN][1] & unoccupied;
       dest = trythose & ~(FIRST_RANK | EIGHTH_RANK);
       fillMoveArray(&m, IN_HAND, PAWN, dest);
       }
@@ -511,7 +522,7 @@ int boardStruct::aiMoves(move *m)
       {
       if (hand[onMove][p]) 
          {
-		 trythose = ~generateToFirst[p][onMove][1] & unoccupied;
+		 trythose = ~toFirst[p][1] & unoccupied;
          fillMoveArray(&m, IN_HAND, p, trythose);
          }
       }
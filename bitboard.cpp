@@ -11,17 +11,16 @@
  *                                                                           *
  *  Comments:																 *
  *                                                                           *
- *            Most of the bitboards go in increasing order of squares (a1 a2 *
- *            a3 a4 ... h8).  But bitboards organized in other ways are also *
- *            used.  There is one that has rank as the lower value, so it    *
- *            goes (a1 b1 c1 d1 ... h8), it's helpful when trying to find    *
- *            out what pieces are on a rank.  Also there are bitboards       *
- *            organized by diagonals (a1 b1 a2 c1 b2 a3 ... h8) to help with *
- *            finding what pieces are on a diagonal.  Although they don't    *
- *            really go in order, some of the diagonals re-aranged.  This is *
- *            so that no diagonal is split over the two 32 bit values in the *
- *            bitboard which allows split shifts to be used (see board.h for *
- *            a description of split shifts).                                *
+ *            The bitboards go in increasing order of squares (a1 a2 a3 a4   *
+ *            ... h8).  Where rooks, bishops and queens attack is looked up  *
+ *            with magic bitboards: the occupied squares that can block a    *
+ *            piece on a square are multiplied with a magic number for that  *
+ *            square, and the leftmost bits of the product are the index     *
+ *            into a table of the attacks.  The magic numbers are chosen so  *
+ *            that occupancies with different attacks never get the same     *
+ *            index.  Compiled with USE_PEXT the pext instruction of BMI2    *
+ *            makes the index instead.  Either way only the plain occupied   *
+ *            bitboards are needed.                                          *
  *                                                                           *
  *************************************************************************** */
 
@@ -29,6 +28,10 @@
 
 #include <stdlib.h>
 
+#ifdef USE_PEXT
+#include <immintrin.h>	// for _pext_u64()
+#endif
+
 #include "board.h"
 #include "bughouse.h"
 #include "interface.h"
@@ -38,9 +41,16 @@
    can be calculated beforehand and so when the value is needed durring a
    search all that as to be done is an index to the array.  */
 
-/* a bitboard where just the one bit is set */
+/* a bitboard where just the one bit is set, none for IN_HAND and 
+   OFF_BOARD, so that the square a piece was dropped from is never set */
+
+qword BitInBB[SQUARES + 2]; 
+
+/* byteSpread has the 8 bits of a byte spread out to the 8 bytes of a
+   qword, so that one file of a bitboard can be added to the 8 attack
+   counters of that file at once */
 
-qword BitInBB[SQUARES]; 
+qword byteSpread[256];
 
 
 /* Attacks is an array of bitboards of where a short range piece attacks from 
@@ -63,6 +73,15 @@ bitboard squaresTo[SQUARES][SQUARES];
 
 bitboard nearSquares[SQUARES][COLORS];
 
+/* kingZoneNumbers are random numbers for the king zone keys, by the color
+   of the king, the color attacking and the square.  kingSquareNumbers add
+   where the king is. */
+
+qword kingZoneNumbers[COLORS][COLORS][SQUARES];
+qword kingSquareNumbers[COLORS][SQUARES];
+
+qword ssrandom64(void);		/* from transposition.cpp */
+
 /* directionPiece either a bishop, rook or none for the piece that can
    move along a line from one one square to the next. */
 
@@ -73,89 +92,88 @@ piece directionPiece[SQUARES][SQUARES];
 
 bitboard squaresPast[SQUARES][SQUARES];
 
-/* urShift and ulShift are to help with the diagonal bitboards.  The square on
-   the up-right diagonal bitboard that corresponds to a normal bitboard is
-   found by indexing urShift.  So square 5 (a6) on a normal bitboard is 24 on
-   the up-right diagonal bitboard (ulShift[5]).  The order of the squares is
-   kind of funky, the only things that are important are that squares of
-   diagonals have adjacent bits and that the 32 bit is the end of one diagonal
-   (so that no diagonals cross 32 bit boundaries and optimizations can be
-   used). */
-
-int ulShift[SQUARES] = 
-   {  
-    0,  2,  5, 13, 18, 24, 31, 39,
-    1,  4, 12, 17, 23, 30, 38, 46,
-    3, 11, 16, 22, 29, 37, 45, 52,
-   10, 15, 21, 28, 36, 44, 51, 57,
-   14, 20, 27, 35, 43, 50, 56,  9,
-   19, 26, 34, 42, 49, 55,  8, 60,
-   25, 33, 41, 48, 54,  7, 59, 62,
-   32, 40, 47, 53,  6, 58, 61, 63 
-   };
+/* A magicEntry has what is needed to look up the attacks of a sliding
+   piece on one square.  mask are the squares that can block it, without
+   the edge of the board (a piece there doesn't block anything behind it).
+   attacks points to where the attacks of this square start in 
+   rookAttacksTable or bishopAttacksTable. */
 
-int urShift[SQUARES] = 
-   {
-   32, 40, 47, 53,  6, 58, 61, 63,
-   25, 33, 41, 48, 54,  7, 59, 62,
-   19, 26, 34, 42, 49, 55,  8, 60,
-   14, 20, 27, 35, 43, 50, 56,  9,
-   10, 15, 21, 28, 36, 44, 51, 57,
-    3, 11, 16, 22, 29, 37, 45, 52,
-    1,  4, 12, 17, 23, 30, 38, 46,
-    0,  2,  5, 13, 18, 24, 31, 39 
-   };
+struct magicEntry {
+  qword mask;
+  qword magic;
+  bitboard *attacks;
+  int shift;			/* 64 - the number of squares in mask */
+};
+
+magicEntry rookMagics[SQUARES];
+magicEntry bishopMagics[SQUARES];
 
-/* urDiagShift and ulDiagShift are to help with the diagonal bitboards.
-   To get the diagonal of a square on the lowest bits of a bitboard, right 
-   shift it by the amout in the array indexed at the square */
+/* The magic numbers were found by trying random numbers with few bits 
+   set until one worked for the square */
 
-int ulDiagShift[SQUARES] = 
+unsigned long long rookMagicNumbers[SQUARES] =
    {
-    0,  1,  3, 10, 14, 19, 25, 32,
-    1,  3, 10, 14, 19, 25, 32, 40,
-    3, 10, 14, 19, 25, 32, 40, 47,
-   10, 14, 19, 25, 32, 40, 47, 53,
-   14, 19, 25, 32, 40, 47, 53,  6,
-   19, 25, 32, 40, 47, 53,  6, 58,
-   25, 32, 40, 47, 53,  6, 58, 61,
-   32, 40, 47, 53,  6, 58, 61, 63
+   0x0080068051E04000ULL, 0x0040001000402000ULL, 0x0080100020008008ULL, 0x4E000A0010208440ULL,
+   0x4200040802002010ULL, 0x0100010008020400ULL, 0x9080608019000600ULL, 0x8100020080204100ULL,
+   0x4103800480400020ULL, 0x8015004004802100ULL, 0x000200108A002040ULL, 0x0801000821001000ULL,
+   0x0015000500080070ULL, 0x0120800400800200ULL, 0x0109000432001100ULL, 0x020080055B000080ULL,
+   0x0080004000402002ULL, 0x5260848020004008ULL, 0x2402020014402080ULL, 0x3000808010000802ULL,
+   0x0304018004810800ULL, 0x0000808004000200ULL, 0x0002040001500248ULL, 0x0012020000408401ULL,
+   0x8440008080004020ULL, 0x0804200840100040ULL, 0x0820008080201000ULL, 0x2080100100082100ULL,
+   0x0001000500100800ULL, 0x00A1000900028400ULL, 0x0100100400C80102ULL, 0x000001120000A044ULL,
+   0x800080C004800620ULL, 0x4040081000202000ULL, 0x0D08802008801000ULL, 0x1000800800801004ULL,
+   0x1004000801010010ULL, 0x0402800400800200ULL, 0x0004080204008110ULL, 0x0000404082000401ULL,
+   0x00C0118861408000ULL, 0x1100220081020048ULL, 0x09A0430420050010ULL, 0x0000082200420010ULL,
+   0x2110080004008080ULL, 0x2004201040680104ULL, 0x1106001451820008ULL, 0x0002224104820014ULL,
+   0x00800C8044210500ULL, 0x02A0200040100040ULL, 0x040100A0001E4100ULL, 0x00204023108A0200ULL,
+   0x2400080080040080ULL, 0x1289008400020900ULL, 0x0002088250010400ULL, 0x0001006084010200ULL,
+   0x0001023480002141ULL, 0x0006400021810015ULL, 0x8400100840200101ULL, 0x40003000A1000825ULL,
+   0x1002011008200402ULL, 0x100D000400080201ULL, 0x0020048806102904ULL, 0x8401000020804201ULL
    };
 
-int urDiagShift[SQUARES] = 
+unsigned long long bishopMagicNumbers[SQUARES] =
    {
-   32, 40, 47, 53,  6, 58, 61, 63,
-   25, 32, 40, 47, 53,  6, 58, 61,
-   19, 25, 32, 40, 47, 53,  6, 58,
-   14, 19, 25, 32, 40, 47, 53,  6,
-   10, 14, 19, 25, 32, 40, 47, 53,
-    3, 10, 14, 19, 25, 32, 40, 47,
-    1,  3, 10, 14, 19, 25, 32, 40,
-    0,  1,  3, 10, 14, 19, 25, 32
+   0x4C40240122060016ULL, 0x8048110404004A80ULL, 0x8004440410414020ULL, 0x021C410060405000ULL,
+   0x80CD1040D0480812ULL, 0x0002021104000082ULL, 0x08440082A8200001ULL, 0x00202A0800841002ULL,
+   0x0200C40810842088ULL, 0x60C0081000C08901ULL, 0x00A3D0040042510CULL, 0x1C00110400808541ULL,
+   0x0400820211084005ULL, 0x0000008860080800ULL, 0x002002020202C000ULL, 0x0400344E08040A81ULL,
+   0x812800102098A080ULL, 0x00202010823A2040ULL, 0x4086400800830201ULL, 0x5008012A22004000ULL,
+   0x0004801C00A00000ULL, 0x0000400200505400ULL, 0x0480408401080820ULL, 0x8000400029082824ULL,
+   0x0008880804501000ULL, 0x0001600048084100ULL, 0x0108220624040400ULL, 0x0008080000820002ULL,
+   0xC804040010410041ULL, 0x01080A0040208400ULL, 0x2018030480A88800ULL, 0x4040410020410810ULL,
+   0x1108044010100210ULL, 0x084A100400029800ULL, 0x0801080100820C00ULL, 0x8010400808108200ULL,
+   0x0084008400020500ULL, 0x0002004200290481ULL, 0x0010150200032090ULL, 0x8404042220404102ULL,
+   0x0302080308004008ULL, 0x1200420820000408ULL, 0x0802002024200800ULL, 0x4020824208000084ULL,
+   0x000002020C008200ULL, 0x2C40208081000882ULL, 0x2082223441000401ULL, 0x8804080081101020ULL,
+   0x4401011002220808ULL, 0x81020C4202100000ULL, 0x4005004404040308ULL, 0x0820400C42020001ULL,
+   0x0020206421820010ULL, 0x0150401001424008ULL, 0x02A20242020C0608ULL, 0x5020110109011200ULL,
+   0x2050840108410401ULL, 0x0100090880842108ULL, 0x220008960142187AULL, 0x1111028880208820ULL,
+   0x4400200042028200ULL, 0x4400010802084206ULL, 0x0000400242040100ULL, 0x0002201104010944ULL
    };
 
+/* The attacks for every occupancy of the mask for every square, a rook
+   has 2^10 to 2^12 of them on each square, a bishop 2^5 to 2^9 */
 
-
-/* *AttacksArray[square][info_on_a_line] gives where a piece can attacks on a line
-   based on where the piece is on the board, and what squares are occupied
-   along the line */
-
-bitboard rankAttacksArray[SQUARES][256];
-bitboard fileAttacksArray[SQUARES][256];
-bitboard diagURAttacksArray[SQUARES][256];
-bitboard diagULAttacksArray[SQUARES][256];
+bitboard rookAttacksTable[0x19000];
+bitboard bishopAttacksTable[0x1480];
 
 
 /* 
- * Function: fileRankSwap
- * Input:    A square
- * Output:   A square with it's rank and file bits swaped
- * Purpose:  Mostly used to get the bit for a mirrored bitboard
+ * Function: magicIndex
+ * Input:    A magicEntry and the occupied squares
+ * Output:   Where in the entry's attacks the attacks for them are
+ * Purpose:  The heart of the magic bitboards.  The multiplication is done
+ *           unsigned, the product is allowed to overflow.
  */
 
-square fileRankSwap(square sq)
+static __forceinline unsigned int magicIndex(magicEntry *m, qword occupied)
    {
-   return ((sq & 7) << 3 ) | sq >> 3;
+#ifdef USE_PEXT
+   return (unsigned int) _pext_u64(occupied, m->mask);
+#else
+   return (unsigned int) (((unsigned long long) (occupied & m->mask) * 
+      (unsigned long long) m->magic) >> m->shift);
+#endif
    }
 
 
@@ -172,63 +190,6 @@ bitboard boardStruct::pawnAttacksFrom(color c, square sq)
    }
 
 
-/* 
- * Function: rankAttacks
- * Input:    A square.
- * Output:   A bitboard of the squares that a rook would attack along the
- *           rank of the square
- * Purpose:  Used to find rank attacks
- */
-
-bitboard boardStruct::rankAttacks(square sq)
-   {
-   return rankAttacksArray[sq][((occupied[WHITE] | occupied[BLACK]) >
-            (sq & 0x38)) & 0xFF];
-   }
-
-
-/* 
- * Function: fileAttacks
- * Input:    A square.
- * Output:   A bitboard of the squares that a rook would attack along the
- *           file of the square
- * Purpose:  Used to find file attacks
- */
-
-bitboard boardStruct::fileAttacks(square sq)
-   {
-   return fileAttacksArray[sq][(occupiedMirror > ((sq << 3) & 0x38)) & 0xFF];
-   }
-
-
-/* 
- * Function: diagULAttacks
- * Input:    A square.
- * Output:   A bitboard of the squares that a bishop would attack along the
- *           diagonal going up and left from the square
- * Purpose:  Used to find diagonal attacks going up and left.
- */
-
-bitboard boardStruct::diagULAttacks(square sq)
-   {
-   return diagULAttacksArray[sq][(occupiedUL > ulDiagShift[sq]) & 0xFF];
-   }
-
-
-/* 
- * Function: diagURAttacks
- * Input:    A square.
- * Output:   A bitboard of the squares that a bishop would attack along the
- *           diagonal going up and right from the square
- * Purpose:  Used to find diagonal attacks going up and right.
- */
-
-bitboard boardStruct::diagURAttacks(square sq)
-   {
-   return diagURAttacksArray[sq][(occupiedUR > urDiagShift[sq]) & 0xFF];
-   }
-
-
 /* 
  * Function: attacksFrom
  * Input:    A piece, the square it's on.
@@ -243,9 +204,11 @@ bitboard boardStruct::attacksFrom(piece p, square sq)
       case KNIGHT:
          return knightAttacks[sq];
       case ROOK:
-         return rankAttacks(sq) | fileAttacks(sq);
+         return rookMagics[sq].attacks[magicIndex(&rookMagics[sq], 
+            occupied[WHITE].data | occupied[BLACK].data)];
       case BISHOP:
-         return  diagULAttacks(sq) | diagURAttacks(sq);
+         return bishopMagics[sq].attacks[magicIndex(&bishopMagics[sq], 
+            occupied[WHITE].data | occupied[BLACK].data)];
       case QUEEN:
          return attacksFrom(ROOK, sq) | attacksFrom(BISHOP, sq);
       case KING:
@@ -331,41 +294,112 @@ bitboard boardStruct::blockedAttacks(color c, square where)
    square sq;
 
    bb = 0;
-   blocked = rankAttacks(where) & (pieces[ROOK] | pieces[QUEEN]) & occupied[c];
+
+   /* squaresPast only has the line from the attacker through where, so
+      the other lines the attacker has don't get in */
+
+   blocked = attacksFrom(ROOK, where) & (pieces[ROOK] | pieces[QUEEN]) & occupied[c];
    while (blocked.hasBits()) 
       {
       sq = firstSquare(blocked.data);
       blocked.unsetSquare(sq);
-      bb |= rankAttacks(sq) & squaresPast[sq][where];
+      bb |= attacksFrom(ROOK, sq) & squaresPast[sq][where];
       }
 
-   blocked = fileAttacks(where) & (pieces[ROOK]|pieces[QUEEN]) & occupied[c];
+   blocked = attacksFrom(BISHOP, where) & (pieces[BISHOP] | pieces[QUEEN]) & occupied[c];
    while (blocked.hasBits()) 
       {
       sq = firstSquare(blocked.data);
       blocked.unsetSquare(sq);
-      bb |= fileAttacks(sq) & squaresPast[sq][where];
+      bb |= attacksFrom(BISHOP, sq) & squaresPast[sq][where];
       }
+   
+   return bb;
+   }
 
-   blocked = diagULAttacks(where) & (pieces[BISHOP]|pieces[QUEEN])&occupied[c];
-   while (blocked.hasBits()) 
+
+/* 
+ * Function: slidingAttacks
+ * Input:    A rook or bishop, the square it's on and the occupied squares
+ * Output:   A bit board of places it attacks
+ * Purpose:  The slow way, square by square in every direction until a 
+ *           piece or the edge is hit.  Only used to fill the magic tables.
+ */
+
+static qword slidingAttacks(piece p, square sq, qword occupied)
+   {
+   static const int rookDirections[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+   static const int bishopDirections[4][2] = { {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+   const int (*directions)[2] = (p == ROOK) ? rookDirections : bishopDirections;
+   qword attacks = 0;
+   int n, f, r;
+
+   for (n = 0; n < 4; n++) 
       {
-      sq = firstSquare(blocked.data);
-      blocked.unsetSquare(sq);
-      bb |= diagULAttacks(sq) & squaresPast[sq][where];
+      f = file(sq) + directions[n][0];
+      r = rank(sq) + directions[n][1];
+
+      while (f >= 0 && f <= 7 && r >= 0 && r <= 7)
+         {
+         attacks |= BitInBB[f * ONE_FILE + r * ONE_RANK];
+         if (occupied & BitInBB[f * ONE_FILE + r * ONE_RANK]) break;
+         f += directions[n][0];
+         r += directions[n][1];
+         }
       }
 
-   blocked = diagURAttacks(where) & (pieces[BISHOP]|pieces[QUEEN])&occupied[c];
-   while (blocked.hasBits()) 
+   return attacks;
+   }
+
+
+/* 
+ * Function: initMagics
+ * Input:    The magicEntries, magic numbers and table of attacks for a rook 
+ *           or bishop
+ * Output:   None
+ * Purpose:  Fills the table with the attacks for every occupancy of every
+ *           square.
+ */
+
+static void initMagics(magicEntry *magics, unsigned long long *magicNumbers, bitboard *table, piece p)
+   {
+   qword edges, b, attacks;
+   unsigned int size;
+   square sq;
+   magicEntry *m;
+
+   for (sq = 0; sq < SQUARES; sq++) 
       {
-      sq = firstSquare(blocked.data);
-      blocked.unsetSquare(sq);
-      bb |= diagURAttacks(sq) & squaresPast[sq][where];
+      m = &magics[sq];
+
+      // the first and last rank and file, unless the piece is on it
+
+      edges = ((0x0101010101010101ULL | 0x8080808080808080ULL) & ~(0x0101010101010101ULL << rank(sq)))
+         | ((qword(0xFF) | (qword(0xFF) << (7 * ONE_FILE))) & ~(qword(0xFF) << (file(sq) * ONE_FILE)));
+
+      m->mask = slidingAttacks(p, sq, 0) & ~edges;
+      m->magic = (qword) magicNumbers[sq];
+      m->shift = 64 - bitboard(m->mask).popCount();
+      m->attacks = table;
+
+      for (size = 0; size < (1u << (64 - m->shift)); size++) m->attacks[size] = qword(0);
+
+      // walk through all subsets of the mask, a magic number never puts
+      // two with different attacks on the same index
+
+      b = 0;
+      do 
+         {
+         attacks = slidingAttacks(p, sq, b);
+
+assert ((m->attacks[magicIndex(m, b)].data == 0) || (m->attacks[magicIndex(m, b)].data == attacks));
+
+         m->attacks[magicIndex(m, b)] = attacks;
+         b = (b - m->mask) & m->mask;
+         } while (b);
+
+      table += size;
       }
-   
-   
-   
-   return bb;
    }
 
 
@@ -392,6 +426,13 @@ void initBitboards()
      // for (sq = 0; sq < (SQUARES+1); sq++) 
      { BitInBB[sq] = (qword(1) << (sq)); }
 
+   for (n = 0; n < 256; n++)
+      {
+      byteSpread[n] = 0;
+      for (o = 0; o < 8; o++)
+         if (n & (1 << o)) byteSpread[n] |= qword(1) << (o * 8);
+      }
+
    /* Generate the attacks of short range pieces.  Just make sure that the
       attacks dont wrap around the board */
 
@@ -466,113 +507,8 @@ void initBitboards()
          }
       }
 
-   for (sq = 0; sq < SQUARES; sq++) 
-      {
- 
-      /* Set up all of the attack bitboards.  The general formula to do this is
-         to start on the square the piece is on.  Then add bits in every 
-         direction until a piece or the edge is hit */
-
-      for (o = 0; o < 256; o++) 
-         {
-         bb = 0;
-
-         if (file(sq) < 7) 
-            {
-            for (i = ONE_FILE; ((1 << file(sq + i)) & o) == 0 && file(sq + i) < 7;
-                 i += ONE_FILE)
-               bb.setSquare(sq + i);
-            bb.setSquare(sq + i);
-            }
-      
-         if (file(sq) > 0) 
-            {
-            for (i = ONE_FILE; ((1 << file(sq - i)) & o) == 0 && file(sq - i) > 0;
-                 i += ONE_FILE)
-               bb.setSquare(sq - i);
-            bb.setSquare(sq - i);
-            }
-
-         fileAttacksArray[sq][o] = bb;
-         }
-    
-      for (o = 0; o < 256; o++) 
-         {
-         bb = 0;
-
-         if (rank(sq) < 7) 
-            {
-            for (i = ONE_RANK; ((1 << rank(sq + i)) & o) == 0 && rank(sq + i) < 7;
-                 i += ONE_RANK)
-               bb.setSquare(sq + i);
-            bb.setSquare(sq + i);
-            }
-
-         if (rank(sq) > 0) 
-            {
-            for (i = ONE_RANK; ((1 << rank(sq - i)) & o) == 0 && rank(sq - i) > 0;
-                 i += ONE_RANK)
-               bb.setSquare(sq - i);
-            bb.setSquare(sq - i);
-            }
-
-         rankAttacksArray[sq][o] = bb;
-         }
-
-      for (o = 0; o < 256; o++) 
-         {
-         bb = 0;
-
-         if (file(sq) < 7 && rank(sq) < 7) 
-            {
-            for (i = ONE_FILE + ONE_RANK;
-                  ((1 << (urShift[sq + i] - urDiagShift[sq + i])) & o) == 0 &&
-                  file(sq + i) < 7 && rank(sq + i) < 7;
-                  i += ONE_FILE + ONE_RANK)
-               bb.setSquare(sq + i);
-            bb.setSquare(sq + i);
-            }
-
-         if (file(sq) > 0 && rank(sq) > 0) 
-            {
-            for (i = ONE_FILE + ONE_RANK;
-                  ((1 << (urShift[sq - i] - urDiagShift[sq - i])) & o) == 0 &&
-                  file(sq - i) > 0 && rank(sq - i) > 0;
-                  i += ONE_FILE + ONE_RANK)
-               bb.setSquare(sq - i);
-            bb.setSquare(sq - i);
-            }
-
-         diagURAttacksArray[sq][o] = bb;
-         }
-
-      for (o = 0; o < 256; o++) 
-         {
-         bb = 0;
-
-         if (rank(sq) < 7 && file(sq) > 0) 
-            {
-            for (i = ONE_RANK - ONE_FILE;
-                  ((1 << (ulShift[sq + i] - ulDiagShift[sq + i])) & o) == 0 && 
-                  rank(sq + i) < 7 && file(sq + i) > 0; 
-                  i += ONE_RANK - ONE_FILE)
-               bb.setSquare(sq + i);
-            bb.setSquare(sq + i);
-            }
-
-         if (rank(sq) > 0 && file(sq) < 7) 
-            {
-            for (i = ONE_RANK - ONE_FILE;
-                  ((1 << (ulShift[sq - i] - ulDiagShift[sq - i])) & o) == 0 &&
-                  rank(sq - i) > 0 && file(sq - i) < 7; 
-                  i += ONE_RANK - ONE_FILE)
-               bb.setSquare(sq - i);
-            bb.setSquare(sq - i);
-            }
-
-      diagULAttacksArray[sq][o] = bb;
-      }
-   }
+   initMagics(rookMagics, rookMagicNumbers, rookAttacksTable, ROOK);
+   initMagics(bishopMagics, bishopMagicNumbers, bishopAttacksTable, BISHOP);
 
     /* Get the squaresTo, squaresPast and directionPiece array.  See if the
        from square is along the same line as to to square, if it is then set
@@ -740,6 +676,16 @@ void initBitboards()
 	  }
   }
 
+  for (sq = 0; sq < SQUARES; sq++)
+  {
+	  for (n = WHITE; n <= BLACK; n++)
+	  {
+		  kingSquareNumbers[n][sq] = ssrandom64();
+		  kingZoneNumbers[n][WHITE][sq] = ssrandom64();
+		  kingZoneNumbers[n][BLACK][sq] = ssrandom64();
+	  }
+  }
+
    return;
    }
 
@@ -776,9 +722,6 @@ void boardStruct::addToBitboards(color c, piece p, square sq)
    {
    occupied[c].setSquare(sq);
    pieces[p].setSquare(sq);
-   occupiedMirror.setSquare(fileRankSwap(sq));
-   occupiedUR.setSquare(urShift[sq]);
-   occupiedUL.setSquare(ulShift[sq]);
    }
  
 
@@ -793,9 +736,6 @@ void boardStruct::removeFromBitboards(color c, piece p, square sq)
    {
    occupied[c].unsetSquare(sq);
    pieces[p].unsetSquare(sq);
-   occupiedMirror.unsetSquare(fileRankSwap(sq));
-   occupiedUR.unsetSquare(urShift[sq]);
-   occupiedUL.unsetSquare(ulShift[sq]);
    }
 
 
@@ -814,41 +754,15 @@ void boardStruct::resetBitboards()
 	first 16 bits on the bitboard, do the same with the last 16 bits for
 	black */
 
-	occupied[WHITE] = qword(0x0303030303030303);
-	occupied[BLACK] = qword(0xC0C0C0C0C0C0C0C0);
-
-	/* Get the mirrored and diagonal bitboards by getting each bit
-	from the occupied bitboards and doing the apropriate transformation */
-
-	updateDiagonalBitboards();
-	
+	occupied[WHITE] = 0x0303030303030303ULL;
+	occupied[BLACK] = 0xC0C0C0C0C0C0C0C0ULL;
 
 	/* Set up the pieces array */
 
-	pieces[PAWN] = qword(0x4242424242424242);
-	pieces[ROOK] = qword(0x8100000000000081);
-	pieces[KNIGHT] = qword(0x0081000000008100);
-	pieces[BISHOP] = qword(0x0000810000810000);
-	pieces[QUEEN] = qword(0x0000000081000000);
-	pieces[KING] = qword(0x0000008100000000);
+	pieces[PAWN] = 0x4242424242424242ULL;
+	pieces[ROOK] = 0x8100000000000081ULL;
+	pieces[KNIGHT] = 0x0081000000008100ULL;
+	pieces[BISHOP] = 0x0000810000810000ULL;
+	pieces[QUEEN] = 0x0000000081000000ULL;
+	pieces[KING] = 0x0000008100000000ULL;
 }
-
-
-
-void boardStruct::updateDiagonalBitboards() {
-	bitboard bb;
-	square sq;
-
-	occupiedUL = occupiedUR = occupiedMirror = 0;
-	bb = occupied[WHITE] | occupied[BLACK];
-	while (bb.hasBits())
-	{
-		sq = firstSquare(bb.data);
-		bb.unsetSquare(sq);
-		occupiedMirror.setSquare(fileRankSwap(sq));
-		occupiedUR.setSquare(urShift[sq]);
-		occupiedUL.setSquare(ulShift[sq]);
-	}
-}
-
-
@@ -17,6 +17,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#ifdef USE_AVX2
+#include <immintrin.h>
+#endif
 
 #include "board.h"
 #include "brain.h"
@@ -31,6 +34,30 @@
 boardStruct gameBoard;
 int hashMoveCircle = 0;
 
+#ifdef USE_AVX2
+
+/* Function: spreadBits
+ * Input:    32 bits of a bitboard
+ * Output:   32 bytes, 0xFF for the squares that are set and 0 for the rest
+ * Purpose:  Lets AVX2 instructions work on only the squares of a bitboard
+ *           in the arrays that have a byte per square, like attacks[].
+ *           Every byte gets the byte of the bitboard its square is in and
+ *           then keeps only its own bit.
+ */
+
+static __forceinline __m256i spreadBits(unsigned int bits)
+{
+	const __m256i whichByte = _mm256_setr_epi8(
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+		2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+	const __m256i whichBit = _mm256_set1_epi64x(0x8040201008040201LL);
+	__m256i v;
+
+	v = _mm256_shuffle_epi8(_mm256_set1_epi32((int) bits), whichByte);
+	return _mm256_cmpeq_epi8(_mm256_and_si256(v, whichBit), whichBit);
+}
+#endif
+
 #ifdef GAMETREE
 /*
  * Function: showPiece
@@ -80,6 +107,135 @@ char * boardStruct::getLineText()
 */ 
 
 
+/* 
+ * Function: changeAttacks
+ * Input:    A color, a bitboard of squares and 1 or -1
+ * Output:   None.
+ * Purpose:  Adds 1 or -1 to the attack counts of the squares.  The counts
+ *           are bytes and never go below 0 or above 127, so a whole file
+ *           can be done with one add or subtract without carries spilling
+ *           over into the next square.  With AVX2 it is all 64 squares in
+ *           two adds.  The bit sliced counts get the bitboard added or
+ *           subtracted one bit at a time, carrying or borrowing into the
+ *           next bit.
+ */
+
+__forceinline void boardStruct::changeAttacks(color c, bitboard bb, int delta)
+   {
+   qword carry = bb.data, t;
+   int n;
+#ifdef USE_AVX2
+   __m256i *row = (__m256i *) attacks[c];
+   __m256i low = spreadBits((unsigned int) bb.data);
+   __m256i high = spreadBits((unsigned int) (bb.data >> 32));
+
+   /* The spread bits are -1 for the squares that change */
+
+   if (delta > 0)
+      {
+      _mm256_storeu_si256(row, _mm256_sub_epi8(_mm256_loadu_si256(row), low));
+      _mm256_storeu_si256(row + 1, _mm256_sub_epi8(_mm256_loadu_si256(row + 1), high));
+      }
+   else
+      {
+      _mm256_storeu_si256(row, _mm256_add_epi8(_mm256_loadu_si256(row), low));
+      _mm256_storeu_si256(row + 1, _mm256_add_epi8(_mm256_loadu_si256(row + 1), high));
+      }
+#else
+   int f;
+
+   if (delta > 0)
+      {
+      for (f = 0; f < 8; f++)
+         attackFiles[c][f] += byteSpread[(bb.data >> (f * 8)) & 0xFF];
+      }
+   else
+      {
+      for (f = 0; f < 8; f++)
+         attackFiles[c][f] -= byteSpread[(bb.data >> (f * 8)) & 0xFF];
+      }
+#endif
+
+   if (delta > 0)
+      {
+      for (n = 0; carry && n < ATTACK_BITS; n++)
+         {
+         t = attackBits[c][n] & carry;
+         attackBits[c][n] ^= carry;
+         carry = t;
+         }
+      }
+   else
+      {
+      for (n = 0; carry && n < ATTACK_BITS; n++)
+         {
+         t = ~attackBits[c][n] & carry;
+         attackBits[c][n] ^= carry;
+         carry = t;
+         }
+      }
+   }
+
+
+/* 
+ * Function: sliceAttacks
+ * Input:    None.
+ * Output:   None.
+ * Purpose:  Sets up the bit sliced attack counts and the board control
+ *           from the attacks array, after that changeAttacks and
+ *           logAttacks keep them up to date.
+ */
+
+void boardStruct::sliceAttacks()
+   {
+   color c;
+   square sq;
+   int n;
+
+   for (c = WHITE; c <= BLACK; c = (color) (c + 1))
+      {
+      for (n = 0; n < ATTACK_BITS; n++)
+         {
+         attackBits[c][n] = 0;
+         for (sq = 0; sq < SQUARES; sq++)
+            if (attacks[c][sq] & (1 << n)) attackBits[c][n] |= BitInBB[sq];
+         }
+      }
+
+   boardControl = countBoardControl();
+   kingZoneKey[WHITE] = countKingZoneKey(WHITE);
+   kingZoneKey[BLACK] = countKingZoneKey(BLACK);
+   }
+
+
+/* 
+ * Function: countKingZoneKey
+ * Input:    The color of the king.
+ * Output:   The key for kingZoneKey.
+ * Purpose:  Adds up the key for the king square and the attack counts on
+ *           the squares near it.  Only needed when the king moves, the
+ *           rest of the time logAttacks adds the changes.  It is a sum and
+ *           not an XOR, so that a count can go up and down by 1.
+ */
+
+qword boardStruct::countKingZoneKey(color c)
+   {
+   qword zone = nearSquares[kingSquare[c]][c].data;
+   qword key = kingSquareNumbers[c][kingSquare[c]];
+   square sq;
+
+   while (zone)
+      {
+      sq = firstSquare(zone);
+      zone &= zone - 1;
+      key += attacks[WHITE][sq] * kingZoneNumbers[c][WHITE][sq] 
+           + attacks[BLACK][sq] * kingZoneNumbers[c][BLACK][sq];
+      }
+
+   return key;
+   }
+
+
 /* 
  * Function: addAttacks
  * Input:    A color a piece and a square
@@ -89,7 +245,7 @@ char * boardStruct::getLineText()
 
 bitboard boardStruct::addAttacks(color c, piece p, square sq)
    {
-   bitboard bb, bb2; 
+   bitboard bb; 
 	
    if (p == PAWN) 
    {
@@ -100,17 +256,10 @@ bitboard boardStruct::addAttacks(color c, piece p, square sq)
       bb = attacksFrom(p, sq);	  
    }
 
-   bb2 = bb; 
-
-   while (bb.hasBits()) 
-      {
-      sq = firstSquare(bb.data);
-      bb.unsetSquare(sq);
-      attacks[c][sq]++;	  
-
-      }
+   logAttacks(c, bb, 1);
+   changeAttacks(c, bb, 1);
 
-   return bb2;
+   return bb;
    }
 
 
@@ -124,26 +273,17 @@ bitboard boardStruct::addAttacks(color c, piece p, square sq)
 
 bitboard boardStruct::removeAttacks(color c, piece p, square sq)
    {
-   bitboard bb,bb2;
-   square sq2;
-
+   bitboard bb;
    
    if (p == PAWN) 
       bb = pawnAttacksFrom(c, sq);
    else 
       bb = attacksFrom(p, sq);
 
-   bb2 = bb;
+   logAttacks(c, bb, -1);
+   changeAttacks(c, bb, -1);
    
-   while (bb.hasBits()) 
-      {
-      sq2 = firstSquare(bb.data);
-      bb.unsetSquare(sq2);
-      attacks[c][sq2]--;
-
-      }
-   
-   return bb2;
+   return bb;
    }
 
 
@@ -158,16 +298,11 @@ bitboard boardStruct::removeAttacks(color c, piece p, square sq)
 bitboard boardStruct::blockAttacks(color c, square where)
    {
    bitboard bb = (qword) 0;
-   square sq;
 
    if (attacks[c][where]) {
    bb = blockedAttacks(c, where);
-   while (bb.hasBits()) 
-      {
-      sq = firstSquare(bb.data);
-      bb.unsetSquare(sq);
-      attacks[c][sq]--;
-      }
+   logAttacks(c, bb, -1);
+   changeAttacks(c, bb, -1);
    }
    return bb; 
 }
@@ -183,24 +318,89 @@ bitboard boardStruct::blockAttacks(color c, square where)
 bitboard boardStruct::uncoverAttacks(color c, square where)
    {
    bitboard bb = (qword) 0;
-   
-   square sq;
 
    if (attacks[c][where])
    {
 	   bb = blockedAttacks(c, where);
-	   while (bb.hasBits())
-	   {
-		   sq = firstSquare(bb.data);
-		   bb.unsetSquare(sq);
-		   attacks[c][sq]++;
-	   }
+	   logAttacks(c, bb, 1);
+	   changeAttacks(c, bb, 1);
    }
 
    return bb; 
    }
 
 
+/* 
+ * Function: logAttacks
+ * Input:    A color, the squares whose attack count changed and by how much
+ * Output:   None.
+ * Purpose:  Remembers a change to the attacks array so that unchangeBoard
+ *           can take it back without a copy of the whole array.  Also
+ *           keeps boardControl and the king zone keys up to date, 
+ *           unchangeBoard puts back the old values.
+ */
+
+void boardStruct::logAttacks(color c, bitboard bb, int delta)
+   {
+   takeBackInfo *t = &takeBackHistory[moveNum];
+   int control;
+   color k;
+   qword zone;
+   square sq;
+
+   if (!bb.hasBits()) return;
+
+   control = countSquares(bb.data & BOARD_CONTROL_SQUARES);
+   boardControl += (c == WHITE) ? delta * control : -delta * control;
+
+   for (k = WHITE; k <= BLACK; k = (color) (k + 1))
+      {
+      zone = bb.data & nearSquares[kingSquare[k]][k].data;
+      while (zone)
+         {
+         sq = firstSquare(zone);
+         zone &= zone - 1;
+         if (delta > 0) kingZoneKey[k] += kingZoneNumbers[k][c][sq];
+         else kingZoneKey[k] -= kingZoneNumbers[k][c][sq];
+         }
+      }
+
+assert (t->attackChangeCount < MAX_ATTACK_CHANGES);
+
+   t->attackChanges[t->attackChangeCount].squares = bb;
+   t->attackChanges[t->attackChangeCount].c = c;
+   t->attackChanges[t->attackChangeCount].delta = delta;
+   t->attackChangeCount++;
+   }
+
+
+/* 
+ * Function: takeBackAttacks
+ * Input:    None.
+ * Output:   None.
+ * Purpose:  Undoes the changes to the attacks array the last move logged.
+ *           They only add and subtract, so the order doesn't matter.
+ *           boardControl and the king zone keys go back to what they were
+ *           before the move.
+ */
+
+void boardStruct::takeBackAttacks()
+   {
+   takeBackInfo *t = &takeBackHistory[moveNum];
+   int n;
+
+   for (n = 0; n < t->attackChangeCount; n++)
+      {
+      changeAttacks(t->attackChanges[n].c, t->attackChanges[n].squares,
+                    -t->attackChanges[n].delta);
+      }
+
+   boardControl = t->oldBoardControl;
+   kingZoneKey[WHITE] = t->oldKingZoneKey[WHITE];
+   kingZoneKey[BLACK] = t->oldKingZoneKey[BLACK];
+   }
+
+
 /* 
  * Function: movePiece
  * Input:    A color and a piece to move and what square it should be moved 
@@ -426,6 +626,31 @@ color otherColor(color c)
    }
 
 
+/* 
+ * Function: changeHand
+ * Input:    A color, a piece and how many to add to that side's hand
+ * Output:   None.
+ * Purpose:  Every change to the hands goes through here, so that the
+ *           worth of the hands and the bonus for them are kept up to date
+ *           for eval().  
+ */
+
+void boardStruct::changeHand(color c, piece p, int n)
+   {
+   int before, after;
+
+   before = hand[c][p] ? handBonus[p] + hand[c][p] * handBonusPerPiece[p] : 0;
+   hand[c][p] += n;
+   after = hand[c][p] ? handBonus[p] + hand[c][p] * handBonusPerPiece[p] : 0;
+
+   handMaterial[c] += n * pValue[p];
+   if (c == WHITE)
+      handAdjustment += after - before;
+   else
+      handAdjustment -= after - before;
+   }
+
+
 /* 
  * Function: addPieceToHand
  * Input:    A color, a piece and if the hash value of the position
@@ -437,7 +662,7 @@ color otherColor(color c)
 void boardStruct::addPieceToHand(color c, piece p, int hash)
    {
 
-   hand[c][p]++;
+   changeHand(c, p, 1);
    if (c == WHITE) 
       material += pValue[p];
    else 
@@ -459,7 +684,7 @@ void boardStruct::addPieceToHand(color c, piece p, int hash)
 void boardStruct::removePieceFromHand(color c, piece p, int hash)
    {
 
-   hand[c][p]--;
+   changeHand(c, p, -1);
    if (c == WHITE) 
       material -= pValue[p];
    else 
@@ -489,7 +714,7 @@ void boardStruct::setPieceInHand(color c, piece p, int num)
       material += (num - hand[WHITE][p]) * pValue[p];
    else
       material -= (num - hand[BLACK][p]) * pValue[p];
-   hand[c][p] = num;
+   changeHand(c, p, num - hand[c][p]);
    }
 
 
@@ -650,7 +875,9 @@ assert ((hashMoveCircle >= 0) && (hashMoveCircle <= 7));
          // no need to use setPieceInHand() which updates material and hash key.
 		  hand[c][p] = 0;
 	  }
+      handMaterial[c] = 0;
    }
+   handAdjustment = 0;
  
    
    kingSquare[WHITE] = E1;
@@ -672,9 +899,10 @@ assert ((hashMoveCircle >= 0) && (hashMoveCircle <= 7));
 
    for (n = 0; n < 64; n++)
       {
-      attacks[WHITE][n] = sword (((attacksTo(n) | (attacksFrom(KING, n) & pieces[KING])) & occupied[WHITE]).popCount());
-      attacks[BLACK][n] = sword (((attacksTo(n) | (attacksFrom(KING, n) & pieces[KING])) & occupied[BLACK]).popCount());
+      attacks[WHITE][n] = byte (((attacksTo(n) | (attacksFrom(KING, n) & pieces[KING])) & occupied[WHITE]).popCount());
+      attacks[BLACK][n] = byte (((attacksTo(n) | (attacksFrom(KING, n) & pieces[KING])) & occupied[BLACK]).popCount());
       }
+   sliceAttacks();
 
    material = 0; 
    initHash();
@@ -736,7 +964,9 @@ void boardStruct::setBoard(const char *fen, const char *turn, const char *castle
 		for (piece p = PAWN; p <= QUEEN; p++) {
 			hand[c][p] = 0;
 		}
+		handMaterial[c] = 0;
 	}
+	handAdjustment = 0;
 	memset(position, NONE, sizeof(position));
 
 	// Pieces
@@ -789,10 +1019,6 @@ void boardStruct::setBoard(const char *fen, const char *turn, const char *castle
 		addPieceToHand(symbolColor(*ch), symbolPiece(*ch), 0);
 	}
 
-	// Update bitboards
-	// this might not be needed because addPiece() already updates the diagonal bitboard, but this needs testing (georg)
-	updateDiagonalBitboards();
-
 	// Turn
 	onMove = (turn[0] == 'b') ? BLACK : WHITE;
 
@@ -835,9 +1061,10 @@ void boardStruct::setBoard(const char *fen, const char *turn, const char *castle
 
 
 	for (int n = 0; n < 64; n++) {
-		attacks[WHITE][n] = sword(((attacksTo(n) | (attacksFrom(KING, n) & pieces[KING])) & occupied[WHITE]).popCount());
-		attacks[BLACK][n] = sword(((attacksTo(n) | (attacksFrom(KING, n) & pieces[KING])) & occupied[BLACK]).popCount());
+		attacks[WHITE][n] = byte(((attacksTo(n) | (attacksFrom(KING, n) & pieces[KING])) & occupied[WHITE]).popCount());
+		attacks[BLACK][n] = byte(((attacksTo(n) | (attacksFrom(KING, n) & pieces[KING])) & occupied[BLACK]).popCount());
 	}
+	sliceAttacks();
 
 	// remember to also zap the hash values (this is currently correctly done in interface.cpp when this function is called)
 	initHash();
@@ -1130,10 +1357,14 @@ void boardStruct::bugChangeBoard(move m)
       of en passant) */  
 
    memcpy(takeBackHistory[moveNum].oldCastle, canCastle, sizeof(takeBackHistory[moveNum].oldCastle));
-   memcpy(takeBackHistory[moveNum].attacks,attacks,  sizeof(attacks));
+   takeBackHistory[moveNum].attackChangeCount = 0;
+   takeBackHistory[moveNum].oldBoardControl = boardControl;
+   takeBackHistory[moveNum].oldKingZoneKey[WHITE] = kingZoneKey[WHITE];
+   takeBackHistory[moveNum].oldKingZoneKey[BLACK] = kingZoneKey[BLACK];
   
    takeBackHistory[moveNum].oldep = enPassant;
    takeBackHistory[moveNum].oldHash = hashValue;
+   takeBackHistory[moveNum].oldPawnHash = pawnHashValue;
 
 #ifdef DEBUG_HASH
    takeBackHistory[moveNum].oldHashT = hashValueT; 
@@ -1245,6 +1476,7 @@ void boardStruct::bugChangeBoard(move m)
       setCastleOptions(onMove, KING_SIDE, 0, 1);
       setCastleOptions(onMove, QUEEN_SIDE, 0, 1);
       kingSquare[onMove] = m.to();
+      kingZoneKey[onMove] = countKingZoneKey(onMove);
       } 
    else if (m.moved() == ROOK) 
       {
@@ -1334,10 +1566,14 @@ void boardStruct::ZHChangeBoard(move m)
       unchangeBoard() has to restore the position. */
 
    memcpy(takeBackHistory[moveNum].oldCastle, canCastle, sizeof(takeBackHistory[moveNum].oldCastle));
-   memcpy(takeBackHistory[moveNum].attacks,attacks,  sizeof(attacks));
+   takeBackHistory[moveNum].attackChangeCount = 0;
+   takeBackHistory[moveNum].oldBoardControl = boardControl;
+   takeBackHistory[moveNum].oldKingZoneKey[WHITE] = kingZoneKey[WHITE];
+   takeBackHistory[moveNum].oldKingZoneKey[BLACK] = kingZoneKey[BLACK];
 
    takeBackHistory[moveNum].oldep = enPassant;
    takeBackHistory[moveNum].oldHash = hashValue;
+   takeBackHistory[moveNum].oldPawnHash = pawnHashValue;
 
 #ifdef DEBUG_HASH
    takeBackHistory[moveNum].oldHashT = hashValueT; 
@@ -1402,12 +1638,12 @@ void boardStruct::ZHChangeBoard(move m)
       
 	  if (!capturedPromotedPawn) 
 	  {
-         hand[onMove][takeBackHistory[moveNum].captured]++;
+         changeHand(onMove, takeBackHistory[moveNum].captured, 1);
 		 addToInHandHash(onMove,takeBackHistory[moveNum].captured );
 	  }
       else 
 	  {
-         hand[onMove][PAWN]++;
+         changeHand(onMove, PAWN, 1);
 		 addToInHandHash(onMove,PAWN );
 	  }
       }
@@ -1469,6 +1705,7 @@ void boardStruct::ZHChangeBoard(move m)
       setCastleOptions(onMove, KING_SIDE, 0, 1);
       setCastleOptions(onMove, QUEEN_SIDE, 0, 1);
       kingSquare[onMove] = m.to();
+      kingZoneKey[onMove] = countKingZoneKey(onMove);
       } 
    else if (m.moved() == ROOK) 
       {
@@ -1542,11 +1779,12 @@ void boardStruct::bugUnchangeBoard()
       addPieceToHand(onMove, moveHistory[moveNum].moved(), 0);
       enPassant = takeBackHistory[moveNum].oldep;
       hashValue = takeBackHistory[moveNum].oldHash;
+      pawnHashValue = takeBackHistory[moveNum].oldPawnHash;
 #ifdef DEBUG_HASH
 	  hashValueT = takeBackHistory[moveNum].oldHashT; 
 #endif
 
-	   memcpy(attacks,takeBackHistory[moveNum].attacks,  sizeof(attacks));
+      takeBackAttacks();
 
       return;
       }
@@ -1589,7 +1827,7 @@ void boardStruct::bugUnchangeBoard()
 
    /* Restore the saved information */
 
-   memcpy(attacks,takeBackHistory[moveNum].attacks,  sizeof(attacks));
+   takeBackAttacks();
 
    setCastleOptions(WHITE, KING_SIDE, takeBackHistory[moveNum].oldCastle[WHITE][KING_SIDE], 0);
    setCastleOptions(WHITE, QUEEN_SIDE, takeBackHistory[moveNum].oldCastle[WHITE][QUEEN_SIDE], 0);
@@ -1597,6 +1835,7 @@ void boardStruct::bugUnchangeBoard()
    setCastleOptions(BLACK, QUEEN_SIDE, takeBackHistory[moveNum].oldCastle[BLACK][QUEEN_SIDE], 0);
    enPassant = takeBackHistory[moveNum].oldep;
    hashValue = takeBackHistory[moveNum].oldHash;
+   pawnHashValue = takeBackHistory[moveNum].oldPawnHash;
 #ifdef DEBUG_HASH
    hashValueT = takeBackHistory[moveNum].oldHashT; 
 #endif
@@ -1660,10 +1899,11 @@ void boardStruct::ZHUnchangeBoard()
       addPieceToHand(onMove, moveHistory[moveNum].moved(), 0);
       enPassant = takeBackHistory[moveNum].oldep;
       hashValue = takeBackHistory[moveNum].oldHash;
+      pawnHashValue = takeBackHistory[moveNum].oldPawnHash;
 #ifdef DEBUG_HASH
 	  hashValueT = takeBackHistory[moveNum].oldHashT; 
 #endif
-	  memcpy(attacks,takeBackHistory[moveNum].attacks,  sizeof(attacks));
+      takeBackAttacks();
       
 	  return;
       }
@@ -1717,11 +1957,11 @@ void boardStruct::ZHUnchangeBoard()
       addPiece(onMove, moveHistory[moveNum].moved(), moveHistory[moveNum].from(), 0, 0);
       if (!takeBackHistory[moveNum].capturedPromotedPawn) 
          {
-         hand[onMove][takeBackHistory[moveNum].captured]--;
+         changeHand(onMove, takeBackHistory[moveNum].captured, -1);
          }
       else 
          {
-         hand[onMove][PAWN]--;
+         changeHand(onMove, PAWN, -1);
          promotedPawns.setSquare(moveHistory[moveNum].to());
          }
       }
@@ -1729,7 +1969,7 @@ void boardStruct::ZHUnchangeBoard()
    /* Restore the saved information */
 
    
-   memcpy(attacks,takeBackHistory[moveNum].attacks,  sizeof(attacks));
+   takeBackAttacks();
    
    setCastleOptions(WHITE, KING_SIDE, takeBackHistory[moveNum].oldCastle[WHITE][KING_SIDE], 0);
    setCastleOptions(WHITE, QUEEN_SIDE, takeBackHistory[moveNum].oldCastle[WHITE][QUEEN_SIDE], 0);
@@ -1738,6 +1978,7 @@ void boardStruct::ZHUnchangeBoard()
 
    enPassant = takeBackHistory[moveNum].oldep;
    hashValue = takeBackHistory[moveNum].oldHash;
+   pawnHashValue = takeBackHistory[moveNum].oldPawnHash;
 #ifdef DEBUG_HASH   
    hashValueT = takeBackHistory[moveNum].oldHashT; 
 #endif
@@ -1854,6 +2095,20 @@ int boardStruct::getMoveNum()
    }
 
 
+/*
+ * Function: getLastMove
+ * Input:    None
+ * Output:   The last move played.
+ * Purpose:  Used by the search for the counter moves.  A null move doesn't
+ *           go into the move history, so after one this is an older move.
+ */
+
+move boardStruct::getLastMove()
+   {
+   return moveHistory[moveNum - 1];
+   }
+
+
 /*
  * Function: getPieceInHand
  * Input:    A piece and a color
@@ -2107,6 +2362,8 @@ void boardStruct::stopIfBad()
 
    return;
    }
+
+ #endif
   
 
 /*
@@ -2142,6 +2399,10 @@ int boardStruct::badMove(move m)
    if (m.moved() != position[m.from()]) 
       return 1;
 
+   /* and so is moving one of the other side's pieces */
+   if (!occupied[onMove].squareIsSet(m.from())) 
+      return 1;
+
    /* Capturing one of your own piece is a no-no */
    if (occupied[onMove].squareIsSet(m.to())) 
       return 1;
@@ -2155,11 +2416,16 @@ int boardStruct::badMove(move m)
       bb = attacksFrom(m.moved(), m.from());
       if (bb.squareIsSet(m.to())) 
          return 0;
-      else if ((m.moved() == KING) && 
-		  (((m.to() == G1) && canCastle[WHITE][KING_SIDE]) || 
-		   ((m.to() == C1) && canCastle[WHITE][QUEEN_SIDE])|| 
-		   ((m.to() == G8) && canCastle[BLACK][KING_SIDE]) ||
-		   ((m.to() == C8) && canCastle[BLACK][QUEEN_SIDE])) )
+      /* Castling needs the squares between king and rook to be empty, or
+         the rook would land on a piece */
+
+      else if ((m.moved() == KING) && (m.to() == m.from() + TWO_FILES) && 
+		  canCastle[onMove][KING_SIDE] && (position[m.to()] == NONE) &&
+		  (position[m.from() + ONE_FILE] == NONE))
+		  return 0; 
+      else if ((m.moved() == KING) && (m.to() == m.from() - TWO_FILES) && 
+		  canCastle[onMove][QUEEN_SIDE] && (position[m.to()] == NONE) &&
+		  (position[m.from() - ONE_FILE] == NONE) && (position[m.from() - THREE_FILES] == NONE))
 		  return 0; 
          
 	  else
@@ -2211,4 +2477,3 @@ int boardStruct::badMove(move m)
          }
       }
    }
- #endif
\ No newline at end of file
@@ -125,7 +125,15 @@ enum gameResult { WHITE_MATE, BLACK_MATE, WHITE_RESIGNATION, BLACK_RESIGNATION,
                                      there isn't a hash move)
 */
 
-extern qword BitInBB[SQUARES]; 
+extern qword BitInBB[SQUARES + 2]; 
+extern qword byteSpread[256];
+
+/* A move is kept in 16 bits in the transposition table: bits 0-5 are the 
+   to square, 6-11 the from square and 12-15 the promotion piece, or for a 
+   drop COMPACT_DROP plus the dropped piece.  0 is no move.  The moved piece 
+   isn't kept, boardStruct::expandMove() takes it from the board. */
+
+#define COMPACT_DROP 8
 
 struct move {
 
@@ -149,6 +157,14 @@ struct move {
   __forceinline piece promotion()         { return (piece) ((data >> 19) & 7); };
   __forceinline int isBad()               { return data >> 23; };
   __forceinline void makeBad()            { data |= 1 << 23; };
+  __forceinline duword getData()          { return data; };
+  __forceinline void setData(duword d)    { data = d; };
+  __forceinline word compact()            
+  { 
+	  if (isBad()) return 0;
+	  if (from() == IN_HAND) return (word) (to() | ((COMPACT_DROP | moved()) << 12));
+	  return (word) (to() | (from() << 6) | (promotion() << 12)); 
+  };
 
 };
 
@@ -293,6 +309,32 @@ int firstSquare(qword a)
 #endif
 
 
+/* Function: countSquares
+ * Input:    bitboard.data , a qword
+ * Output:   How many squares are set
+ * Purpose:  Like bitboard::popCount() but fast and it leaves the bitboard
+ *           alone.  Uses the popcnt instruction if the compiler may.
+ */
+
+#if defined(__GNUC__) && defined(__POPCNT__)
+inline
+int countSquares(qword a)
+{
+	return __builtin_popcountll(a);
+}
+#else
+__forceinline int countSquares(qword a)
+{
+	unsigned long long x = a;
+
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int) ((x * 0x0101010101010101ULL) >> 56);
+}
+#endif
+
+
 /* *Attacks is where a piece attacks from a square */
 
 extern bitboard pawnAttacks[COLORS][SQUARES];
@@ -315,19 +357,40 @@ extern bitboard squaresPast[SQUARES][SQUARES];
 
 extern bitboard nearSquares[SQUARES][COLORS];
 
+/* The random numbers for the king zone keys, see countKingZoneKey() */
+
+extern qword kingZoneNumbers[COLORS][COLORS][SQUARES];
+extern qword kingSquareNumbers[COLORS][SQUARES];
+
 /* directionPiece is a bishop, rook or none, depending on what line moving
    piece can move from the first square to the second */
 
 extern piece directionPiece[SQUARES][SQUARES];
 
+/* The squares boardControlEval() counts, B1 to G8 */
+
+#define BOARD_CONTROL_SQUARES qword(0x00FFFFFFFFFFFF00)
+
+/* attackChange is one set of squares whose attack count a move changed */
+
+struct attackChange {
+  bitboard squares;
+  color c;
+  int delta;
+};
+
 /* takeBackInfo has stuff to take back a move */
 
 struct takeBackInfo {
-  sword attacks[COLORS][64];
+  attackChange attackChanges[MAX_ATTACK_CHANGES];
+  int attackChangeCount;
+  int oldBoardControl;
+  qword oldKingZoneKey[COLORS];
   piece captured;
   byte oldCastle[COLORS][2];
   square oldep; 
   qword oldHash;
+  qword oldPawnHash;
 
 #ifdef DEBUG_HASH
   qword oldHashT; 
@@ -336,12 +399,13 @@ struct takeBackInfo {
   byte capturedPromotedPawn; /* Only used in crazyhouse */
 };
 
-							/* transpositionEntry is what the transposition 
-							tables are built on */
+							/* transpositionEntry is what lookup() hands
+							out, unpacked from a hashBucket, and what old
+							learn files were made of */
 
 #ifdef _win32_
-#pragma pack(4)				/* I don't know why I need to do this to pack 
-							the table entry in 16 byte */
+#pragma pack(4)				/* So that it is 16 bytes like the records of 
+							old learn files */
 #endif
 
 struct transpositionEntry {
@@ -350,7 +414,9 @@ struct transpositionEntry {
   byte depth;				/* How deep the position was searched */
   
   sword value;              /* The value of the position */
-  qword hash : 48;          /* The upper 48 bits of the hash value of the  position. */
+  qword hash : 48;          /* The upper 48 bits of the hash value of the
+							position, lookup() fills it in, the table 
+							doesn't keep it */
 #ifdef DEBUG_HASH   
   qword hashT : 48;			/* To check for hash collisions */
 #endif
@@ -363,6 +429,27 @@ struct transpositionEntry {
 #pragma pack(8)
 #endif
 
+							/* A bucket keeps HASH_BUCKET_SIZE entries.  All
+							fields of an entry and some bits of the key are
+							packed into one 64 bit word, which is read and
+							written in one go, so threads can't see half a 
+							write.  The check word holds more bits of the 
+							key, xor-ed with the entry, so that a check of 
+							another write makes a miss.  No locking needed.
+							All entries of a bucket fit in half a cache 
+							line so that a lookup costs at most one cache
+							miss */
+
+struct hashBucket {
+  qword data[HASH_BUCKET_SIZE];	/* type, moveNr, depth, value, hashMove and
+							some bits of the key */
+  word check[HASH_BUCKET_SIZE];	/* more bits of the key */
+  word unused;
+#ifdef DEBUG_HASH   
+  qword hashT[HASH_BUCKET_SIZE];	/* To check for hash collisions */
+#endif
+};
+
 
 							// Utilities for the board
 
@@ -373,7 +460,8 @@ void initBitboards();       // Must be called durring initialization
 void initializeEval();  
 
 void initializeHistory();	// Used to create the "good" moves in aimoves first. 
-void updateHistory(move m, int depth);
+void updateHistory(move m, int depth, color c);
+int isHistoryMove(move m, color c);	// If the history likes the move
 void makeHistoryOld(); 
 
 
@@ -383,6 +471,26 @@ int rank(square sq);
 int file(square sq);
 
 void zapHashValues();
+void newGameHashValues(int valuesChanged);
+void clearEvalCache();
+
+extern qword *evalCache;			/* from evaluate.cpp */
+extern qword evalCacheMask;
+extern thread_local int stats_evalCacheProbes, stats_evalCacheHits;
+extern thread_local int stats_kingSafetyProbes, stats_kingSafetyHits;
+extern thread_local int stats_lazyEvalTries, stats_lazyEvalCuts, stats_lazyEvalErrors;
+extern thread_local int stats_pawnHashProbes, stats_pawnHashHits;
+
+								/* The stats above of one search thread, 
+								kept when the thread is done */
+struct evalStats {
+  int evalCacheProbes, evalCacheHits;
+  int kingSafetyProbes, kingSafetyHits;
+  int lazyEvalTries, lazyEvalCuts;
+  int pawnHashProbes, pawnHashHits;
+};
+
+void saveEvalStats(evalStats *s);
 
 
 								/* The board structure. */
@@ -397,17 +505,17 @@ struct boardStruct {
   bitboard moveAttackedSomething[MAX_GAME_LENGTH];
 								 /* Which squares the last move directly attacked */
 
-  bitboard occupiedMirror;       /* What squares are occupied, but with the
-									file and rank bits switched */
-  bitboard occupiedUR;           /* What squares are occupied, organized by
-									diagonals going up and to the left */
-  bitboard occupiedUL;           /* What squares are occupied, organized by
-                                    diagonals going up and to the left */
   bitboard pieces[PIECES];       /* What squares are occupied by each piece */
   
   square kingSquare[COLORS];     /* Where each king is */
   
-  sword attacks[COLORS][64];       /* How well each color attacks a square */
+  union {
+    byte attacks[COLORS][64];    /* How well each color attacks a square */
+    qword attackFiles[COLORS][8];/* The same counters a file at a time */
+  };
+  qword attackBits[COLORS][ATTACK_BITS];
+								 /* The same counters bit sliced, bit n
+								    of every count is in attackBits[c][n] */
   int hand[COLORS][PIECES];      /* What is in the player's hands */
   int whiteTime;                 /* Time in 1/100th seconds on white's clock */
   int blackTime;                 /* Time in 1/100th seconds on black's clock */
@@ -441,6 +549,8 @@ struct boardStruct {
   
   qword hashValue;               /* The hash value for the position, used for
 									the transposition table. */
+  qword pawnHashValue;           /* The same for only the pawns and kings, 
+									used for the pawn hash table. */
 #ifdef DEBUG_HASH
   qword hashValueT; 
 #endif
@@ -462,6 +572,12 @@ struct boardStruct {
   int material;                 /* The relative material with positive 
 									 meaning white is up in material */
   int development;              /* The relative delelopment */
+  int boardControl;             /* White's attacks minus black's on
+									 BOARD_CONTROL_SQUARES */
+  int handMaterial[COLORS];     /* What the pieces in each hand are worth */
+  int handAdjustment;           /* adjustInHand(), kept up to date */
+  qword kingZoneKey[COLORS];    /* The king square and the attack counts
+									 near it, kingSafetyEval() caches by it */
 
   public:                       /* Primitives to access the variables */
 
@@ -497,7 +613,6 @@ struct boardStruct {
   void resetBitboards();        /* resets the bitboards for a new
 									game */
 
-  void updateDiagonalBitboards(); /* Creates the diagonal bitboards when the others are already set, niklasf */
 
   int playMove(move m, int report);
 								/* Plays a move. */
@@ -534,6 +649,8 @@ struct boardStruct {
 									and move now */
 
   int getMoveNum();
+  move getLastMove();           /* The move that led to this position, not
+                                   meaningful after a null move */
 
 
   int isNotRepDrawSearch();  /* FALSE if the position has been repeated or 50 moves rule */
@@ -581,6 +698,7 @@ struct boardStruct {
   int captureGain(color c, move m);			/* How much material a move gains */
   
   move *orderCaptures(move *m);				/* Orders captures based on material gain*/
+  int scoreCaptures(move *m, int *values);	/* The gains orderCaptures sorts by */
 
   void captureMovesTo(move *m, square sq);	/* Fills an array of moves with
 												captures to a certain square */
@@ -594,8 +712,11 @@ struct boardStruct {
 
   int eval();                  /* eval() evaluates the position and
 								 returns the value */
+  int computeEval();			/* the uncached part of eval(), white's view */
+  int lazyEval(int alpha, int beta);	/* eval() or a bound outside the window */
 
   int adjustInHand();
+  int countHandAdjustment();
 
   int bughouseSitForEval();		/* Malus in Bughouse if we'd have to sit for a piece */
   int bughouseMateEval();		/* see above, for mates */ 
@@ -631,10 +752,8 @@ struct boardStruct {
 										split into components 
 										in the prinicpal variation */
 
- #ifndef NDEBUG
-
   int badMove(move m);				 /* True if a move is bad (not just illegal)*/
- #endif
+
   /* Other primitives */
  #ifndef NDEBUG
   void showDebugInfo();               /* Prints debuging information to the
@@ -646,9 +765,20 @@ struct boardStruct {
   void store(int depthSearched, move bestMove,	/* Stores a position in the */
         int value, int alpha, int beta, int ply);		/* transposition tables */
 
-  transpositionEntry *lookup();                 /* Attempts to look up the
+  qword tableKey();								/* hashValue with the side to
+												move */
+
+  void prefetchHash();							/* Loads the bucket lookup() 
+												will need into the cache */
+
+  move expandMove(word compactMove);			/* The reverse of 
+												move::compact() */
+
+  transpositionEntry *lookup(transpositionEntry *te);
+												/* Attempts to look up the
 												position from the 
-												transposition tables */
+												transposition tables, fills
+												te if it is there */
 
   int checkLearnTable(); 
   void saveLearnTable(int pointsWon); 
@@ -694,20 +824,26 @@ struct boardStruct {
   bitboard attacksTo(square sq);
   bitboard blockedAttacks(color c, square where);
   int isAttacked(color c, square sq);
-  bitboard fileAttacks(square sq);
-  bitboard rankAttacks(square sq);
-  bitboard diagULAttacks(square sq);
-  bitboard diagURAttacks(square sq);
   
   bitboard addAttacks(color c, piece p, square sq);
   bitboard removeAttacks(color c, piece p, square sq);
   bitboard blockAttacks(color c, square sq);
   bitboard uncoverAttacks(color c, square sq);
+  void changeAttacks(color c, bitboard bb, int delta);
+  void logAttacks(color c, bitboard bb, int delta);
+  void takeBackAttacks();
+  void sliceAttacks();
+  void changeHand(color c, piece p, int n);
+  qword countKingZoneKey(color c);
 
   /* These help out eval() */
 
   int kingSafetyEval(color c); 
+  int countKingSafety(color c);
+  int pawnStructureEval();
+  int countPawnStructure(color c);
   int boardControlEval();
+  int countBoardControl();
   int getMaterialInHand(color c); /* gets the values of material in hand */
 
   /* These help out making moves */
@@ -19,6 +19,8 @@
 #ifndef _BRAIN_
 #define _BRAIN_
 
+#include <atomic>
+
 #include "board.h"
 #include "interface.h"
 
@@ -50,6 +52,11 @@
 /* Stuff for search extensions.  These can be in fractions of one ply.  */
 #define ONE_PLY               4
 
+/* The size of the late move reduction tables, deeper and later than this
+   counts as the last entry */
+#define LMR_DEPTHS 32
+#define LMR_MOVES 64
+
 /* Define PrincipalVariation which is a struct to hold the best moves by
    both sides that Sunsetter searched */
 
@@ -82,16 +89,27 @@ extern int		NK_FACTOR;
 extern int		BC_FACTOR;  
 extern int		DE_FACTOR;  
 
+extern int		LMR_BASE;
+extern int		LMR_DIVISOR;
+extern int		LMR_DROP_BASE;
+extern int		LMR_DROP_DIVISOR;
+
 extern int		paramA;
 extern int		paramB;
 
+extern int		CORES;
+
 
 extern int pValue[PIECES]; 
 
 extern int DevelopmentTable[COLORS][PIECES][64];   /* How good it is to have a
                                                    piece on a square */
 
-extern bitboard generateToFirst[PIECES][COLORS][2]; 
+extern int handBonus[PIECES];            /* How good it is to have pieces */
+extern int handBonusPerPiece[PIECES];    /* in hand */
+
+extern std::atomic<qword> generateToFirst[PIECES][COLORS][2];  /* History, 
+												loaded relaxed */
 
 extern int hashMoveCircle;
 
@@ -104,13 +122,114 @@ extern int tryToPonder;                         /* If we should try to
                                                    ponder */
 
 extern int learning;							/* If we should use the learn file */
+extern qword learnSize;							/* How big a new learn file is made */
 extern int analyzeMode;							/* If we should not make a move 
 												   ever and accept all move input */
 extern int xboardMode;							/* should we send "tellics" stuff */
 
-/* AIBoard is the board Sunsetter uses to think */
+/* SearchContext holds everything a search changes while it runs: the board
+   the AI thinks on, the move stacks, the principal variation and the
+   counters.  The main search uses mainSearch, every helper thread gets its
+   own context, and a pointer to it is passed down through search() and
+   quiesce().  Only the transposition table is shared. */
+
+struct SearchContext {
+
+  boardStruct AIBoard;                      /* The board that the AI uses */
+  move searchMoves[DEPTH_LIMIT][MAX_MOVES]; /* Where to store the moves.  They
+                                               used to be in a local array, but
+                                               that blew up the stack */
+  int moveValues[DEPTH_LIMIT][MAX_MOVES];   /* What the MovePicker sorts the
+                                               captures by */
+  PrincipalVariation pv;
+  move killers[DEPTH_LIMIT][2];             /* The last two quiet moves that
+                                               cut off at each ply */
+  move counterMoves[COLORS][PIECES][SQUARES]; /* The quiet move that cut off
+                                               after the opponent moved that
+                                               piece to that square */
+
+  volatile int stopThinking;                /* If this search should be stopped */
+  int threadNumber;                         /* 0 for the main search, 1.. for helpers */
+  int currentDepth;
+  int movesSearched;
+
+  int stats_positionsSearched;              /* # of search() done */
+  int stats_quiescensePositionsSearched;    /* # of quiesce() done */
+  int stats_transpositionHits;              /* # of success for transposition lookups*/
+  int stats_cutoffs;                        /* # of cutoffs in recursivePicked() */
+  int stats_firstMoveCutoffs;               /* # of those by the first move */
+  int stats_pvsTries;                       /* # of null window searches at PV nodes */
+  int stats_pvsReSearches;                  /* # of those that failed high */
+  int stats_lmrTries;                       /* # of reduced searches */
+  int stats_lmrReSearches;                  /* # of those that failed high */
+  int stats_aspirationFailLows[MAX_SEARCH_DEPTH + 1];  /* # of root re-searches */
+  int stats_aspirationFailHighs[MAX_SEARCH_DEPTH + 1]; /* by iteration */
+  evalStats stats_eval;                     /* see saveEvalStats() */
+
+#ifdef DEBUG_STATS
+  int stats_forceext, stats_checkext, stats_capext;
+  int stats_NullTries[DEPTH_LIMIT], stats_NullCuts[DEPTH_LIMIT];
+  int stats_RazorTries, stats_Razors;
+  int stats_MakeUnmake[MOVEGEN_TYPES];
+#endif
+
+};
 
-extern boardStruct AIBoard;
+extern SearchContext mainSearch;              /* The context of the main search */
+
+/* What a node is expected to be.  A PV_NODE has an open window, its first
+   move is searched with that window and the others with a null window, and
+   again with the open one if they fail high.  A CUT_NODE is expected to
+   fail high, an ALL_NODE to fail low, both only get null windows. */
+
+#define PV_NODE 0
+#define CUT_NODE 1
+#define ALL_NODE 2
+
+/* The stages a MovePicker goes through.  A stage is only generated when
+   the moves of the stages before it didn't give a cutoff. */
+
+#define PICK_HASH_MOVE 0
+#define PICK_START_CAPTURES 1
+#define PICK_GOOD_CAPTURES 2
+#define PICK_KILLERS 3
+#define PICK_START_QUIET_MOVES 4
+#define PICK_QUIET_MOVES 5
+#define PICK_START_MATE_TRIES 6
+#define PICK_MATE_TRIES 7
+#define PICK_DONE 8
+
+/* MovePicker hands out the moves of a node one at a time: the hash move,
+   the captures that gain material best first, then with ALL_NON_CAP the
+   killers and the counter move and the other quiet moves and drops in
+   history order, or with MATE_TRIES only the mate tries. */
+
+struct MovePicker {
+
+  boardStruct *board;
+  move hashMove;
+  move refutations[3];          /* The killers and the counter move */
+  int refutationCount;          /* How many of them are valid here */
+  int nextRefutation;
+  move *moves;                  /* Captures first, then the quiet moves */
+  int *values;                  /* captureGain() of each capture */
+  int searchType;               /* ALL_NON_CAP or MATE_TRIES */
+  int captureCount;
+  int nextCapture;              /* The captures before it are handed out */
+  int current, end;             /* The quiet moves or mate tries left */
+  int stage;                    /* The stage to go on with */
+  int picked;                   /* The stage the last move came from */
+
+  MovePicker(boardStruct *b, move *m, int *v, move hash, int type);
+  void setRefutations(move *killer, move counter);
+  move nextMove();
+  int moveType();               /* What stats_MakeUnmake counts it as */
+
+  private:
+
+  void selectCapture();
+  int isRefutation(move m);
+};
 
 /* Now some function prototypes */
 
@@ -122,14 +241,25 @@ void ponder(void);                            /* Called by the main loop
                                                  when it's Sunsetter's
                                                  opponent's move */
 
-int search(int alpha, int beta,
-           int depth, int ply, int wasNullMove); /* Uses a recursive alpha-beta
+int search(SearchContext *sc, int alpha, int beta,
+           int depth, int ply, int nodeType,
+           int wasNullMove);                  /* Uses a recursive alpha-beta
                                                  search to assign a value to
                                                  the position. */
 
 
 
-int quiesce(int alpha, int beta, int ply);    
+void initReductions();                        /* Fills lmrReductions from
+                                                 the LMR_ options */
+
+void clearRefutations(SearchContext *sc);    /* Empties the killers and
+                                                 counter moves */
+
+void storeRefutation(SearchContext *sc, move m, move lastMove, int ply);
+                                              /* Remembers a quiet move that
+                                                 cut off */
+
+int quiesce(SearchContext *sc, int alpha, int beta, int ply);    
 											  /* evaluates the position with a
 												 quiescense search*/
 
@@ -154,6 +284,9 @@ void doMove(move m);                          /* Makes Sunsetter play a move
 void resetAI(void);                           /* Stop all thinking about
                                                  moves */
 
+void stopHelperThreads(void);                 /* Stops the threads helping
+                                                 the search when CORES > 1 */
+
 
 
 void saveLearnTableToDisk();				  /* Guess what this does :) */
@@ -90,8 +90,10 @@ int		FIXED_NODES;
 int		CAPTURE_EXTENSION,CHECK_EXTENSION,FORCING_EXTENSION ; 
 int		NK_FACTOR, BC_FACTOR, DE_FACTOR; 
 int		CC_DEPTH, NULL_REDUCTION; 
+int		LMR_BASE, LMR_DIVISOR, LMR_DROP_BASE, LMR_DROP_DIVISOR;
 int		paramA = 0;
 int		paramB = 0;
+int		CORES = 1;		/* Number of threads searching, set with "cores" */
 
 int		pValue[PIECES]  = {0, 0, 0, 0, 0, 0, 0 };  
 
@@ -144,6 +146,13 @@ NULL_REDUCTION=  2; /* How much to reduce search on NullMove
 					  some tactical shots. Normal values are 1-3 */
 
 
+LMR_BASE = 50;			/* Late move reductions: quiet moves are reduced  */
+LMR_DIVISOR = 250;		/* by BASE + log(depth) * log(move number) / DIVISOR */
+LMR_DROP_BASE = 50;		/* plies, both in hundredths, drops by the DROP_ */
+LMR_DROP_DIVISOR = 200;	/* pair.  See initReductions() */
+initReductions(); 
+
+
 NK_FACTOR = 5;   /* Factor for the more precise King Safety eval which 
 					takes material into account. */			   
 			
@@ -260,6 +269,16 @@ int main(int argc, char **argv)
 	return 0; 
   }
 
+  if(argc > 1 && !strcmp(argv[1], "hashtest")) 
+  
+  {    
+	/* If the first argument that Sunsetter is given is
+	  "hashtest" then let many threads store and look up
+	  positions in the transposition table at the same time */
+    initialize();
+	return hashtest(argc, argv);	
+  }
+
 
   initialize();
 
@@ -418,7 +437,7 @@ void initialize()
 
 
 
-  if(makeTranspositionTable(MIN_HASH_SIZE)) 
+  if(makeTranspositionTable(MIN_HASH_SIZE) || makeEvalCache(EVAL_CACHE_SIZE)) 
   {
 	fprintf(stderr, "Not enough memory!\n");
 	exit(1);
@@ -65,10 +65,14 @@ void ReadIniFile(char *filename);
 
 void initialize();
 void setDefaultValues(); 
-int makeTranspositionTable(unsigned int size);
+int makeTranspositionTable(qword size);
+int makeEvalCache(qword size);
+int saveTranspositionTable(const char *fileName);
+int loadTranspositionTable(const char *fileName);
 
 int testbpgn(int argc, char **argv);
 int speedtest(int argc, char **argv);
+int hashtest(int argc, char **argv);
 
 
 // Those are already defined in some win32 library
@@ -25,6 +25,42 @@
 
 int DevelopmentTable[COLORS][PIECES][SQUARES];
 
+/* What having pieces of a kind in hand is worth on top of their material,
+   handBonus[] for having any and handBonusPerPiece[] for each of them */
+
+int handBonus[PIECES] = { 0, 15, 20, 20, 20, 40, 0 };
+int handBonusPerPiece[PIECES] = { 0, 7, 10, 10, 10, 20, 0 };
+
+/* The eval cache, one qword per entry: the upper 48 bits of the hashValue
+   and the white point of view value of computeEval() in the low 16 bits */
+
+qword *evalCache = NULL;
+qword evalCacheMask;
+thread_local int stats_evalCacheProbes, stats_evalCacheHits;
+
+/* The king safety values by kingZoneKey, the same layout as evalCache.  It
+   is small and only used by its own search thread. */
+
+thread_local qword kingSafetyCache[KING_SAFETY_CACHE_SIZE];
+thread_local int stats_kingSafetyProbes, stats_kingSafetyHits;
+
+/* How often lazyEval() got by without king safety, and how often it 
+   shouldn't have */
+
+thread_local int stats_lazyEvalTries, stats_lazyEvalCuts, stats_lazyEvalErrors;
+
+/* The pawn structure terms, see countPawnStructure() */
+
+#define SHIELD_BONUS 10
+#define HOLE_MALUS 8
+#define DOUBLED_MALUS 12
+#define ISOLATED_MALUS 10
+
+/* The pawn structure values by pawnHashValue, the same layout as evalCache */
+
+thread_local qword pawnHashTable[PAWN_HASH_SIZE];
+thread_local int stats_pawnHashProbes, stats_pawnHashHits;
+
 int escapeValues[32] = { 2, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4 };
 
 /* Function: boardControlEval
@@ -40,66 +76,133 @@ int boardStruct::boardControlEval()
 	// Testing shows BC_FACTOR of 5 is clearly better than i.e. 3 (= unchanged)
 	// Testing shows counting 2nd row twice is clearly worse (= unchanged)
 
+	// boardControl is kept up to date by logAttacks()
+
+assert (boardControl == countBoardControl());
+
+	return (boardControl * BC_FACTOR);
+	
+
+}
+
+/* Function: countBoardControl
+ * Input:    None.
+ * Output:   int
+ * Purpose:  Counts boardControl from scratch, from the bit sliced attack
+ *           counts of the B to G files
+ */
+
+int boardStruct::countBoardControl()
+{
+
 	int control = 0;
-	square sq; 
+	int n; 
 
-	for (sq = B1; sq <= G8; sq++)
+	for (n = 0; n < ATTACK_BITS; n++)
 
 		{
-			control += ((attacks[WHITE][sq] - attacks[BLACK][sq]));
+			control += (countSquares(attackBits[WHITE][n] & BOARD_CONTROL_SQUARES)
+				- countSquares(attackBits[BLACK][n] & BOARD_CONTROL_SQUARES)) << n;
 		}
 
-	return (control * BC_FACTOR);
-	
+	return control;
 
 }
 
 /* Function: kingSafetyEval
  * Input:    the color to compute King Safety for.
  * Output:   int
- * Purpose:  Returns the King Safety part of the evaluation
+ * Purpose:  Returns the King Safety part of the evaluation.  It only depends
+ *           on the king square and the attack counts near the king, which
+ *           kingZoneKey stands for, so it is looked up by that first.
  */
 
 int boardStruct::kingSafetyEval(color c)
 {
+	qword key = kingZoneKey[c];
+	qword *entry = &kingSafetyCache[key & (KING_SAFETY_CACHE_SIZE - 1)];
+	int value;
 
-	int escapeSquares = 0;
-	int takeSquares = 0; 
-
-	int sqcontrol;
-	square sq; 
-	bitboard nearKing;
+assert (key == countKingZoneKey(c));
 
-	nearKing = nearSquares[kingSquare[c]][c];
+	stats_kingSafetyProbes++;
 
-	while (nearKing.hasBits())
+	if (((*entry ^ key) & ~qword(0xFFFF)) == 0)
 	{
-		sq = firstSquare(nearKing.data);
-		nearKing.unsetSquare(sq);
+		stats_kingSafetyHits++;
+		value = (int) (*entry & 0xFFFF);
+assert (value == countKingSafety(c));
+		return value;
+	}
+
+	value = countKingSafety(c);
+	if (value <= 0xFFFF) *entry = (key & ~qword(0xFFFF)) | value;
+
+	return value;
+}
+
+/* Function: countKingSafety
+ * Input:    the color to compute King Safety for.
+ * Output:   int
+ * Purpose:  Works out what kingSafetyEval() returns
+ */
 
-		sqcontrol = attacks[otherColor(c)][sq] - attacks[c][sq];
+int boardStruct::countKingSafety(color c)
+{
 
+	int escapeSquares;
+	int takeSquares; 
 
-		// Squares we attack at least as much as opp near opps king (dont forget opps king!)
-		// Tuning: this version is at least 30 elo points better than version 8
-		// I also tried "+= sqcontrol + 10" or "+= sqcontrol + sqcontrol + 7"
-		// but this (with lower values) is better
+	int sqcontrol = 0;
+	int n;
+	qword *own = attackBits[c];
+	qword *opp = attackBits[otherColor(c)];
+	qword nearKing, same, less, take, escape;
+	qword oppAttacks = 0, ownAttacks = 0, ownTwice = 0;
 
-		if (sqcontrol > -1)
-		{
-			takeSquares += sqcontrol + sqcontrol + 5;
-		}
+	nearKing = nearSquares[kingSquare[c]][c].data;
 
-		// Bonus for escape squares near our own king 
-		// squares that are not attacked by opp	
-		// This doesnt convince me but all testing shows it is better with than without:
+	// Compare the bit sliced counts from the top bit down, less are the 
+	// squares opp attacks less often than we do
 
-		if ((!attacks[otherColor(c)][sq]))
-		{
-			escapeSquares += escapeValues[attacks[c][sq]];
-		}
+	same = nearKing;
+	less = 0;
+
+	for (n = ATTACK_BITS - 1; n >= 0; n--)
+	{
+		less |= same & ~opp[n] & own[n];
+		same &= ~(opp[n] ^ own[n]);
+
+		oppAttacks |= opp[n];
+		ownAttacks |= own[n];
+		if (n) ownTwice |= own[n];
+	}
+
+	// Squares we attack at least as much as opp near opps king (dont forget opps king!)
+	// Tuning: this version is at least 30 elo points better than version 8
+	// I also tried "+= sqcontrol + 10" or "+= sqcontrol + sqcontrol + 7"
+	// but this (with lower values) is better
+
+	take = nearKing & ~less;
+
+	for (n = 0; n < ATTACK_BITS; n++)
+	{
+		sqcontrol += (countSquares(opp[n] & take) - countSquares(own[n] & take)) << n;
 	}
 
+	takeSquares = sqcontrol + sqcontrol + 5 * countSquares(take);
+
+	// Bonus for escape squares near our own king 
+	// squares that are not attacked by opp	
+	// This doesnt convince me but all testing shows it is better with than without:
+	// (escapeValues is the same from 2 attacks on)
+
+	escape = nearKing & ~oppAttacks;
+
+	escapeSquares = escapeValues[0] * countSquares(escape)
+		+ (escapeValues[1] - escapeValues[0]) * countSquares(escape & ownAttacks)
+		+ (escapeValues[2] - escapeValues[1]) * countSquares(escape & ownTwice);
+
 	// this ensures that there is always a positive effect of attacking near-king squares even if 
 	// we attack so few squares that the escape-Squares are overwhelming.
 	// Tuning shows it works clearly better than without
@@ -113,6 +216,108 @@ int boardStruct::kingSafetyEval(color c)
 
 }
 
+/* Function: pawnStructureEval
+ * Input:    None.
+ * Output:   int
+ * Purpose:  Returns the pawn structure part of the evaluation, white's 
+ *           point of view.  It only depends on where the pawns and kings 
+ *           are, so it is looked up by pawnHashValue first.
+ */
+
+int boardStruct::pawnStructureEval()
+{
+	qword key = pawnHashValue;
+	qword *entry = &pawnHashTable[key & (PAWN_HASH_SIZE - 1)];
+	int value;
+
+	stats_pawnHashProbes++;
+
+	if (((*entry ^ key) & ~qword(0xFFFF)) == 0)
+	{
+		stats_pawnHashHits++;
+		value = (sword) (*entry & 0xFFFF);
+assert (value == countPawnStructure(WHITE) - countPawnStructure(BLACK));
+		return value;
+	}
+
+	value = countPawnStructure(WHITE) - countPawnStructure(BLACK);
+	*entry = (key & ~qword(0xFFFF)) | (word) value;
+
+	return value;
+}
+
+/* Function: countPawnStructure
+ * Input:    the color to compute the pawn structure for.
+ * Output:   int
+ * Purpose:  Bonus for pawns in front of a king on its first two ranks, 
+ *           malus for holes there that no pawn of ours can ever cover and
+ *           which the other side can drop into, and for doubled and 
+ *           isolated pawns.
+ */
+
+int boardStruct::countPawnStructure(color c)
+{
+	qword pawns = pieces[PAWN].data & occupied[c].data;
+	qword span = pawns, fileMask, shield, near, far;
+	int f, n, value = 0;
+	int kf = file(kingSquare[c]), kr = rank(kingSquare[c]);
+
+	// Doubled and isolated pawns, a file is one byte
+
+	for (f = 0; f < 8; f++)
+	{
+		n = countSquares(pawns & (qword(0xFF) << (f * 8)));
+		if (!n) continue;
+
+		value -= (n - 1) * DOUBLED_MALUS;
+
+		fileMask = 0;
+		if (f > 0) fileMask |= qword(0xFF) << ((f - 1) * 8);
+		if (f < 7) fileMask |= qword(0xFF) << ((f + 1) * 8);
+		if (!(pawns & fileMask)) value -= n * ISOLATED_MALUS;
+	}
+
+	// Only a king on its first two ranks has a shield
+
+	if ((c == WHITE) ? (kr > 1) : (kr < 6)) return value;
+
+	// The squares our pawns can still attack: fill every pawn forward in
+	// its file, then one file to either side
+
+	if (c == WHITE)
+	{
+		span |= (span << 1) & qword(0xFEFEFEFEFEFEFEFE);
+		span |= (span << 2) & qword(0xFCFCFCFCFCFCFCFC);
+		span |= (span << 4) & qword(0xF0F0F0F0F0F0F0F0);
+		span = (span << 1) & qword(0xFEFEFEFEFEFEFEFE);
+		near = qword(0x0202020202020202);
+		far = qword(0x0404040404040404);
+	}
+	else
+	{
+		span |= (span >> 1) & qword(0x7F7F7F7F7F7F7F7F);
+		span |= (span >> 2) & qword(0x3F3F3F3F3F3F3F3F);
+		span |= (span >> 4) & qword(0x0F0F0F0F0F0F0F0F);
+		span = (span >> 1) & qword(0x7F7F7F7F7F7F7F7F);
+		near = qword(0x4040404040404040);
+		far = qword(0x2020202020202020);
+	}
+	span = (span << 8) | (span >> 8);
+
+	// The king's file and the ones next to it
+
+	fileMask = qword(0xFF) << (kf * 8);
+	fileMask |= (fileMask << 8) | (fileMask >> 8);
+
+	shield = (near | far) & fileMask;
+
+	value += SHIELD_BONUS * countSquares(pawns & near & fileMask) 
+		+ (SHIELD_BONUS / 2) * countSquares(pawns & far & fileMask);
+	value -= HOLE_MALUS * countSquares(shield & ~span & ~pawns);
+
+	return value;
+}
+
 #ifdef GAMETREE
 
 
@@ -195,10 +400,32 @@ int boardStruct::getPieceDevOnSquare(color c, square sq, piece p)
 
 #endif  // GAMETREE
 
+/* Function: adjustInHand
+ * Input:    None.
+ * Output:   int
+ * Purpose:  Returns the bonus for pieces in hand, white's minus black's.
+ *           It is kept up to date by changeHand().
+ */
+
 int boardStruct::adjustInHand()
 
 {
-	// TODO: for speeding up the eval this could be put into the development variable on movegen
+
+assert (handAdjustment == countHandAdjustment());
+
+	return handAdjustment;
+}
+
+/* Function: countHandAdjustment
+ * Input:    None.
+ * Output:   int
+ * Purpose:  Counts adjustInHand() from scratch, to check handBonus[] and
+ *           changeHand() in debug builds
+ */
+
+int boardStruct::countHandAdjustment()
+
+{
 
 	int mAjustment = 0;
 
@@ -229,6 +456,20 @@ int boardStruct::adjustInHand()
 		return mAjustment;
 }
 
+/* Function: computeEval
+ * Input:    None.
+ * Output:   The value of the position from white's point of view.
+ * Purpose:  Does the static evaluation that eval() caches.  Everything in it
+ *           depends only on what hashValue covers, the bughouse sitting malus
+ *           depends on the partner and is added by eval() instead.
+ */
+
+int boardStruct::computeEval()
+
+{
+  return( adjustInHand() + material + development + boardControlEval() + pawnStructureEval() - kingSafetyEval(WHITE) * getMaterialInHand(BLACK) + kingSafetyEval(BLACK) * getMaterialInHand(WHITE));
+}
+
 /* Function: eval
  * Input:    None.
  * Output:   The value of the position.
@@ -238,17 +479,163 @@ int boardStruct::adjustInHand()
 int boardStruct::eval()
 
 {
+  int value;
+  qword *entry, data;
+
+  if (evalCache == NULL) 
+  {
+    value = computeEval();
+  }
+  else
+  {
+    stats_evalCacheProbes++;
+
+    entry = &evalCache[hashValue & evalCacheMask];
+    data = *entry;   // read once, another thread might be writing it
+
+    if (((data ^ hashValue) & ~qword(0xFFFF)) == 0)
+    {
+      stats_evalCacheHits++;
+      value = (sword) (data & 0xFFFF);
+assert (value == computeEval());
+    }
+    else
+    {
+      value = computeEval();
+      if (value == (sword) value) 
+        *entry = (hashValue & ~qword(0xFFFF)) | (word) value;
+    }
+  }
+
+  value += bughouseSitForEval();
 
   if (onMove == WHITE) // it is whites turn NOW. 
   {
-    return( adjustInHand() + material   +  development + boardControlEval() - kingSafetyEval(WHITE) * getMaterialInHand(BLACK)+ kingSafetyEval(BLACK) * getMaterialInHand(WHITE) + bughouseSitForEval());
+    return value;
   }
   else // blacks turn
   { 
-	  return(-(adjustInHand() +  material + development + boardControlEval() - kingSafetyEval(WHITE) * getMaterialInHand(BLACK) + kingSafetyEval(BLACK) * getMaterialInHand(WHITE) + bughouseSitForEval()));
+    return -value;
   }
+}
 
- 
+/* Function: lazyEval
+ * Input:    alpha and beta.
+ * Output:   The value of the position, or a bound outside alpha - beta.
+ * Purpose:  Used where only a value inside the window matters.  Everything
+ *           but king safety is kept up to date by the move functions, so
+ *           that part costs almost nothing.  If it is more than
+ *           LAZY_EVAL_MARGIN outside the window the king safety terms can't
+ *           bring it back in, then the bound on the far side of the window
+ *           is returned without them.
+ */
+
+int boardStruct::lazyEval(int alpha, int beta)
+
+{
+  int value;
+
+  value = adjustInHand() + material + development + boardControlEval() + pawnStructureEval() + bughouseSitForEval();
+  if (onMove != WHITE) value = -value;
+
+  stats_lazyEvalTries++;
+
+  if (value + LAZY_EVAL_MARGIN <= alpha)
+  {
+    stats_lazyEvalCuts++;
+#ifdef DEBUG_STATS
+    if (eval() > alpha) stats_lazyEvalErrors++;
+#endif
+    return value + LAZY_EVAL_MARGIN;
+  }
+
+  if (value - LAZY_EVAL_MARGIN >= beta)
+  {
+    stats_lazyEvalCuts++;
+#ifdef DEBUG_STATS
+    if (eval() < beta) stats_lazyEvalErrors++;
+#endif
+    return value - LAZY_EVAL_MARGIN;
+  }
+
+  return eval();
+}
+
+/* Function: saveEvalStats
+ * Input:    Where to put them.
+ * Output:   None.
+ * Purpose:  The eval stats are thread_local, eval() has no SearchContext.
+ *           Every search thread saves them in its context before it ends,
+ *           so they can be added up for all threads.
+ */
+
+void saveEvalStats(evalStats *s)
+{
+  s->evalCacheProbes = stats_evalCacheProbes;
+  s->evalCacheHits = stats_evalCacheHits;
+  s->kingSafetyProbes = stats_kingSafetyProbes;
+  s->kingSafetyHits = stats_kingSafetyHits;
+  s->lazyEvalTries = stats_lazyEvalTries;
+  s->lazyEvalCuts = stats_lazyEvalCuts;
+  s->pawnHashProbes = stats_pawnHashProbes;
+  s->pawnHashHits = stats_pawnHashHits;
+}
+
+/* Function: makeEvalCache
+ * Input:    The size of the cache in bytes, 0 turns it off.
+ * Output:   0 if it worked, -1 if there wasn't enough memory.
+ * Purpose:  (Re)allocates the eval cache.  It is direct-mapped, so the number
+ *           of entries is rounded down to a power of 2.
+ */
+
+int makeEvalCache(qword size)
+{
+  char buf[MAX_STRING];
+  qword entries;
+
+  stopHelperThreads();  // they might be using the old cache
+
+  free(evalCache);
+  evalCache = NULL;
+  evalCacheMask = 0;
+
+  entries = size / sizeof(qword);
+  if (entries == 0) 
+  {
+    output("Eval cache turned off.\n");
+    return 0;
+  }
+
+  while (entries & (entries - 1)) entries &= entries - 1;
+
+  evalCache = (qword *) malloc((size_t) entries * sizeof(qword));
+  if (evalCache == NULL)
+  {
+    output("Not enough memory to make the eval cache\n");
+    return -1;
+  }
+  evalCacheMask = entries - 1;
+  clearEvalCache();
+
+  sprintf(buf, "Created %lld byte eval cache.\n", (long long)(entries * sizeof(qword)));
+  output(buf);
+  return 0;
+}
+
+/* Function: clearEvalCache
+ * Input:    None.
+ * Output:   None.
+ * Purpose:  Empties the eval cache, the evaluation parameters or the variant
+ *           might have changed.  An all zero entry would match a hashValue
+ *           of 0, so the empty slots get the key of 1 instead.
+ */
+
+void clearEvalCache()
+{
+  qword n;
+
+  for (n = 0; n <= evalCacheMask && evalCache != NULL; n++)
+    evalCache[n] = qword(0x10000);
 }
 
 /* Function:	bughouseMateEval
@@ -310,13 +697,7 @@ int boardStruct::bughouseSitForEval()
 int boardStruct::getMaterialInHand(color c)
 
 {
-int mInHand = 0;
-piece p;
-
-for (p=FIRST_PIECE; p <= LAST_PIECE; p = (piece)(p + 1) ) 
-{
-	mInHand+= (pValue[p]* hand[c][p]);
-}
+int mInHand = handMaterial[c];
 
 	int calcReturn = 2;
 
@@ -626,13 +626,14 @@ void parseOption(const char *str)
 		// Tell xboard which modern features we support.  short list so far.
 		// Remember that "string" features must be quoted even when they do
 		// not have any spaces in them.
-		sprintf(buf, "feature ping=0 draw=0 sigint=0 setboard=1 analyze=1 memory=1 myname=\"Sunsetter%s%d%d\" variants=\"crazyhouse,bughouse\" done=1\n", VERSION, paramA, paramB);
+		sprintf(buf, "feature ping=0 draw=0 sigint=0 setboard=1 analyze=1 memory=1 smp=1 myname=\"Sunsetter%s%d%d\" variants=\"crazyhouse,bughouse\" done=1\n", VERSION, paramA, paramB);
 		output(buf);
 	}
 
 	else if (!strcmp(arg[0], "learn")) 
 		{
 		learning = 1; 
+		if (atoi(arg[1]) > 0) learnSize = (qword) atoi(arg[1]) * 1024 * 1024;
 		readLearnTableFromDisk(); 
 		output("Learning is on.\n");
 		}
@@ -644,7 +645,7 @@ void parseOption(const char *str)
 			output("requested hash size too small, using default\n");
 			hashgoal = 16;
 		}
-		makeTranspositionTable(hashgoal * 1024 * 1024); // hashgoal megabytes
+		makeTranspositionTable((qword) hashgoal * 1024 * 1024); // hashgoal megabytes
 }
 
 	else if (!strcmp(arg[0], "analyze")) 
@@ -737,6 +738,7 @@ void parseOption(const char *str)
    else if(!strcmp(arg[0], "variant") ||
            !strcmp(arg[0], "reset")) 
       {
+	  rules newRules;
 
 
 	  if (xboardMode && !analyzeMode) 
@@ -765,7 +767,11 @@ void parseOption(const char *str)
 		
 	  stopThought(); 
 	  gameBoard.resetBoard();
-      zapHashValues();
+
+	  // a personality comes with its own piece values
+
+	  newRules = !strcmp(arg[1], "bughouse") ? BUGHOUSE : CRAZYHOUSE;
+      newGameHashValues(PERSONALITY || (newRules != currentRules));
       resetAI();
 	  
       gameInProgress = 1;
@@ -774,7 +780,7 @@ void parseOption(const char *str)
 #ifdef DEBUG_XBOARD
 output ("//D: variant parsed, board reset and set to bug or zh \n"); 
 #endif
-			if (!strcmp(arg[1], "bughouse")) 
+			if (newRules == BUGHOUSE) 
 				{				
 				currentRules = BUGHOUSE;
 				gameBoard.playBughouse();
@@ -837,12 +843,28 @@ output ("//D: variant parsed, board reset and set to bug or zh \n");
    
    else if(!strcmp(arg[0], "hash")) 
       {	  
-      if (makeTranspositionTable(atoi(arg[1]) * 1024 * 1024) == -1)
+      if (makeTranspositionTable((qword) atoi(arg[1]) * 1024 * 1024) == -1)
          makeTranspositionTable(MIN_HASH_SIZE); 
 		 /* There was an error, so make the
                   table the minimum size. */
       }
 
+   else if(!strcmp(arg[0], "evalcache")) 
+      {	  
+      if (makeEvalCache((qword) atoi(arg[1]) * 1024 * 1024) == -1)
+         makeEvalCache(0); 
+      }
+
+   else if(!strcmp(arg[0], "hashsave")) 
+      {
+      saveTranspositionTable(arg[1]);
+      }
+
+   else if(!strcmp(arg[0], "hashload")) 
+      {
+      loadTranspositionTable(arg[1]);
+      }
+
    else if (!strcmp(arg[0], "tellics"))
 		{ output("\ntellics "); output(arg[1]); output("\n");  }
    
@@ -869,6 +891,18 @@ output ("//D: variant parsed, board reset and set to bug or zh \n");
    else if(!strcmp(arg[0], "nullreduct"))
 	  { NULL_REDUCTION = atoi(arg[1]); }
 
+   else if(!strcmp(arg[0], "lmrbase"))
+	  { LMR_BASE = atoi(arg[1]); initReductions(); }
+
+   else if(!strcmp(arg[0], "lmrdiv"))
+	  { LMR_DIVISOR = atoi(arg[1]); initReductions(); }
+
+   else if(!strcmp(arg[0], "lmrdropbase"))
+	  { LMR_DROP_BASE = atoi(arg[1]); initReductions(); }
+
+   else if(!strcmp(arg[0], "lmrdropdiv"))
+	  { LMR_DROP_DIVISOR = atoi(arg[1]); initReductions(); }
+
    else if(!strcmp(arg[0], "capext"))
 	  { CAPTURE_EXTENSION = atoi(arg[1]); }
    
@@ -908,6 +942,13 @@ output ("//D: variant parsed, board reset and set to bug or zh \n");
    {
 	   paramB = atoi(arg[1]);
    }
+
+   else if (!strcmp(arg[0], "cores"))
+   {
+	   CORES = atoi(arg[1]);
+	   if (CORES < 1) CORES = 1;
+	   if (CORES > MAX_THREADS) CORES = MAX_THREADS;
+   }
    
    else if(!strcmp(arg[0], "time"))
       gameBoard.setTime(gameBoard.getDeepBugColor(), atoi(arg[1]) *10);
@@ -995,11 +1036,13 @@ output ("//D: variant parsed, board reset and set to bug or zh \n");
 #endif
    else if (!strcmp(arg[0], "setboard")) 
    {
+	   int rulesChanged = (currentRules != CRAZYHOUSE);
+
 	   stopThought();
 	   currentRules = CRAZYHOUSE;
 	   gameBoard.playCrazyhouse();
 	   gameBoard.setBoard(arg[1], arg[2], arg[3], arg[4]);
-	   zapHashValues();
+	   newGameHashValues(rulesChanged);
 	   resetAI();
 
 	   gameInProgress = 1;
@@ -1080,8 +1123,7 @@ output ("//D: variant parsed, board reset and set to bug or zh \n");
 		 // if (analyzeMode) gameBoard.setDeepBugColor(gameBoard.getColorOnMove());  
 		/* Instead of the line above 7g Angrims Code (havnt yet checked why) */
 		 if (analyzeMode) {
-			 extern int stats_positionsSearched;
-			 stats_positionsSearched = 0;
+			 mainSearch.stats_positionsSearched = 0;
 			 gameBoard.setDeepBugColor(gameBoard.getColorOnMove());
 			 gameBoard.setLastMoveNow();
 			 startSearchOver();
@@ -1151,16 +1193,32 @@ void giveMove(move m)
  * Input:    None
  * Output:   long
  * Purpose:  Returns the system time in Milliseconds, independent from the OS.
+ *           On unix clock() is the CPU time of all threads together, which
+ *           runs CORES times too fast when searching with helper threads, so
+ *           the wall clock is used there.
  */
 
 long getSysMilliSecs()
 {
+#if !defined(_win32_) && !defined(__EMSCRIPTEN__)
+
+static long startSecs = 0;
+struct timeval tv;
+
+gettimeofday(&tv, NULL);
+if (!startSecs) startSecs = tv.tv_sec;
+
+return (tv.tv_sec - startSecs) * 1000 + tv.tv_usec / 1000;
+
+#else
+
 double tmp; 
 
 tmp=clock();
 tmp*=1000; 
 return long((tmp / CLOCKS_PER_SEC)) ; 
 
+#endif
 }
 
 
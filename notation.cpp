@@ -501,7 +501,7 @@ move boardStruct::algebraicMoveToDBMove(const char *notation)
 
 /*
  * Function: printHtmlBoard
- * Input:    a file
+ * Input:    a file and the board to show
  * Output:   None.
  * Purpose:  writes the part of a html file that shows the actual board position. 
  *           
@@ -510,7 +510,7 @@ move boardStruct::algebraicMoveToDBMove(const char *notation)
 
 #ifdef GAMETREE
 
-void printHtmlBoard (FILE *fi)
+void printHtmlBoard (FILE *fi, boardStruct &AIBoard)
 
 {
   int n, n3; 
@@ -21,7 +21,7 @@ void DBMoveToRawAlgebraicMove(move m, char *str);
 void getHoldingString(char *str);
 
 #ifdef GAMETREE
-void printHtmlBoard (FILE *fi); 
+void printHtmlBoard (FILE *fi, boardStruct &AIBoard); 
 #endif
 
 #endif
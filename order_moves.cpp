@@ -11,6 +11,7 @@
  *************************************************************************** */
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "board.h"
 #include "brain.h"
@@ -20,27 +21,63 @@
 
 
 
+/* The history is shared by all search threads.  Only the main thread 
+   updates it (see search()), the helpers just read generateToFirst while 
+   it does.  So valueToSquares is a plain array and generateToFirst is 
+   made of relaxed atomics: a reader always gets a whole bitboard, old or 
+   new, and no ordering is needed, a slightly old history only sorts the
+   moves a bit differently. */
+
 qword valueToSquares [SQUARES][PIECES][COLORS][2]; 
 
-bitboard generateToFirst[PIECES][COLORS][2]; 
+std::atomic<qword> generateToFirst[PIECES][COLORS][2]; 
+
+
+/*
+ * Function: historySquares
+ * Input:    A piece, a color and whether it is about drops
+ * Output:   The squares it went to best before
+ * Purpose:  Reads one bitboard of generateToFirst
+ */
+
+static __forceinline bitboard historySquares(piece p, color c, int isDrop)
+
+{
+	return bitboard(generateToFirst[p][c][isDrop].load(std::memory_order_relaxed)); 
+}
+
+
+/*
+ * Function: setHistorySquares
+ * Input:    A piece, a color, whether it is about drops and the squares
+ * Output:   none
+ * Purpose:  Writes one bitboard of generateToFirst
+ */
+
+static __forceinline void setHistorySquares(piece p, color c, int isDrop, bitboard bb)
+
+{
+	generateToFirst[p][c][isDrop].store(bb.data, std::memory_order_relaxed); 
+}
 
 
 /*
  * Function: updateHistory
- * Input:    A move, and the depth to horizon at current node
+ * Input:    A move, the depth to horizon at current node and the side that
+ *           played the move
  * Output:   none
  * Purpose:  used for the move generation in AIMoves to generate moves to fields that used to be good first. 
  *           
  */
 
-void updateHistory(move m, int depth )
+void updateHistory(move m, int depth, color c)
 
 {
 	piece p2;
 	square sq; 
+	bitboard bb;
 
 
-	color c = AIBoard.getColorOnMove(); 
 	piece p = m.moved();
 	square sqto = m.to(); 	
 	int isDrop = 0; 
@@ -56,14 +93,14 @@ void updateHistory(move m, int depth )
 
 	// if this square is already one of the "good" ones, we can return now. 
 	
-	if (generateToFirst[p][c][isDrop].squareIsSet(sqto)) return; 
+	if (historySquares(p, c, isDrop).squareIsSet(sqto)) return; 
 
 	
 	for (p2 = FIRST_PIECE; p2 <= QUEEN ; p2 = (piece) (p2 + 1))
 
 	{
 
-		bitboard bb = generateToFirst[p2][c][0]; 
+		bb = historySquares(p2, c, 0); 
 
 		while (bb.hasBits())
 		{					
@@ -74,18 +111,23 @@ void updateHistory(move m, int depth )
 			if (valueToSquares [sqto][p][c][isDrop] > valueToSquares[sq][p2][c][0])
 			{				
 				
-				assert (generateToFirst[p2][c][0].squareIsSet(sq)) ;
-				assert (!generateToFirst[p][c][isDrop].squareIsSet(sqto));
+				assert (historySquares(p2, c, 0).squareIsSet(sq)) ;
+				assert (!historySquares(p, c, isDrop).squareIsSet(sqto));
 								
-				generateToFirst[p2][c][0].unsetSquare(sq);
-				generateToFirst[p][c][isDrop].setSquare(sqto); 				 
+				bb = historySquares(p2, c, 0); 
+				bb.unsetSquare(sq);
+				setHistorySquares(p2, c, 0, bb); 
+
+				bb = historySquares(p, c, isDrop); 
+				bb.setSquare(sqto);
+				setHistorySquares(p, c, isDrop, bb); 
 
 				goto breakloop; 
 
 			}
 		}
 
-		bb = generateToFirst[p2][c][1]; 
+		bb = historySquares(p2, c, 1); 
 
 		while (bb.hasBits())
 		{					
@@ -97,11 +139,16 @@ void updateHistory(move m, int depth )
 			if (valueToSquares [sqto][p][c][isDrop] > valueToSquares[sq][p2][c][1])
 			{
 				
-				assert (generateToFirst[p2][c][1].squareIsSet(sq)) ;
-				assert (!generateToFirst[p][c][isDrop].squareIsSet(sqto));
+				assert (historySquares(p2, c, 1).squareIsSet(sq)) ;
+				assert (!historySquares(p, c, isDrop).squareIsSet(sqto));
 				
-				generateToFirst[p2][c][1].unsetSquare(sq);
-				generateToFirst[p][c][isDrop].setSquare(sqto); 
+				bb = historySquares(p2, c, 1); 
+				bb.unsetSquare(sq);
+				setHistorySquares(p2, c, 1, bb); 
+
+				bb = historySquares(p, c, isDrop); 
+				bb.setSquare(sqto);
+				setHistorySquares(p, c, isDrop, bb); 
 
 				goto breakloop; 
 
@@ -117,6 +164,20 @@ return;
 }
 
 
+/*
+ * Function: isHistoryMove
+ * Input:    A move and the side that plays it
+ * Output:   1 if it goes to one of the squares updateHistory() found good
+ * Purpose:  The search reduces these moves less.
+ */
+
+int isHistoryMove(move m, color c)
+
+{
+	return historySquares(m.moved(), c, m.from() == IN_HAND).squareIsSet(m.to());
+}
+
+
 /*
  * Function: initializeHistory
  * Input:    none
@@ -132,24 +193,24 @@ void initializeHistory()
 	square sq; 
 	piece p; 
 	color c; 
+	bitboard center = qword(0); 
+
+	center.setSquare(E4); 
+	center.setSquare(D4); 
+	center.setSquare(E5); 
+	center.setSquare(D5); 
+
+	center.setSquare(E3); 
+	center.setSquare(D3); 
+	center.setSquare(E6); 
+	center.setSquare(D6); 
 
 	for (p = FIRST_PIECE; p <= LAST_PIECE; p = (piece) (p + 1))
 	{
 		for (c = FIRST_COLOR; c <= LAST_COLOR; c = (color) (c + 1))
 		{
-			generateToFirst[p][c][0] = qword(0); 
-			generateToFirst[p][c][1] = qword(0); 
-
-
-			generateToFirst[p][c][0].setSquare(E4); 
-			generateToFirst[p][c][0].setSquare(D4); 
-			generateToFirst[p][c][0].setSquare(E5); 
-			generateToFirst[p][c][0].setSquare(D5); 
-
-			generateToFirst[p][c][0].setSquare(E3); 
-			generateToFirst[p][c][0].setSquare(D3); 
-			generateToFirst[p][c][0].setSquare(E6); 
-			generateToFirst[p][c][0].setSquare(D6); 
+			setHistorySquares(p, c, 0, center); 
+			setHistorySquares(p, c, 1, qword(0)); 
 
 
 			for (sq = 0; sq < SQUARES; sq++)
@@ -201,18 +262,70 @@ return;
 
 
 /*
- * Function: orderCaptures
- * Input:    An array of moves
- * Output:   The first move that isn't a material gaining capture
- * Purpose:  Used by aiMoves() to put the captures in the decending order so
- *           that the best ones are looked at first, used in quiesce to order moves.
+ * Function: clearRefutations
+ * Input:    A search context
+ * Output:   none
+ * Purpose:  Empties the killers and counter moves before a search, they
+ *           only mean something for the position they were found in.
  */
 
-move *boardStruct::orderCaptures(move *m)
+void clearRefutations(SearchContext *sc)
+
+{
+	move none;
+	int ply, c, p, sq;
+
+	none.setData(0);
+	none.makeBad();
+
+	for (ply = 0; ply < DEPTH_LIMIT; ply++)
+	{
+		sc->killers[ply][0] = sc->killers[ply][1] = none;
+	}
+
+	for (c = 0; c < COLORS; c++)
+		for (p = 0; p < PIECES; p++)
+			for (sq = 0; sq < SQUARES; sq++)
+				sc->counterMoves[c][p][sq] = none;
+}
+
+
+/*
+ * Function: storeRefutation
+ * Input:    A search context, the quiet move that cut off, the move before
+ *           it (bad after a null move) and the ply
+ * Output:   none
+ * Purpose:  Makes the move the first killer of the ply, the old first one
+ *           becomes the second, and the counter move to lastMove.
+ */
+
+void storeRefutation(SearchContext *sc, move m, move lastMove, int ply)
+
+{
+	if (sc->killers[ply][0] != m)
+	{
+		sc->killers[ply][1] = sc->killers[ply][0];
+		sc->killers[ply][0] = m;
+	}
+
+	if (!lastMove.isBad())
+	{
+		sc->counterMoves[sc->AIBoard.getColorOffMove()][lastMove.moved()][lastMove.to()] = m;
+	}
+}
+
+
+/*
+ * Function: scoreCaptures
+ * Input:    An array of captures and one for their values
+ * Output:   The number of captures
+ * Purpose:  Works out how much material each capture gains and remembers
+ *           the best gain in bestCaptureGain for the razoring conditions
+ */
+
+int boardStruct::scoreCaptures(move *m, int *values)
    {
-   move tmpMove;
-   int values[MAX_MOVES], done, count, tmpVal, i;
-   values[0] = 0; // needed for the case of 0 capture moves
+   int count, best = 0;
 
    for (count = 0; !m[count].isBad(); count++)
       {
@@ -227,8 +340,30 @@ move *boardStruct::orderCaptures(move *m)
 		   // TODO FIX this
 		   values[count] = pValue[KNIGHT];
 	   }
+	   if (values[count] > best) best = values[count];
       }
 
+   bestCaptureGain[moveNum] = best;
+   return count;
+   }
+
+
+/*
+ * Function: orderCaptures
+ * Input:    An array of moves
+ * Output:   The first move that isn't a material gaining capture
+ * Purpose:  Used by aiMoves() to put the captures in the decending order so
+ *           that the best ones are looked at first, used in quiesce to order moves.
+ */
+
+move *boardStruct::orderCaptures(move *m)
+   {
+   move tmpMove;
+   int values[MAX_MOVES], done, count, tmpVal, i;
+   values[0] = 0; // needed for the case of 0 capture moves
+
+   count = scoreCaptures(m, values);
+
 
    // @georg : make sure this isnt triggered when there are 2 moves, which are then not ordered ... 
    if (count < 2)
@@ -239,8 +374,6 @@ move *boardStruct::orderCaptures(move *m)
 	   // (R should be called minor in crazyhouse) is not considered 
 	   // a winning capture. 
 
-     bestCaptureGain[moveNum] = max (0, values[0]);
-	   
 	 if (values[0] < +20) return m;
 	 else return m + count;
    }
@@ -264,8 +397,6 @@ move *boardStruct::orderCaptures(move *m)
             }
       } while(!done);
 
-   bestCaptureGain[moveNum] = max (0, values[0]);
-
    if (values[0] < +20)
       return m;
    while (values[count - 1] < +20)
@@ -273,3 +404,231 @@ move *boardStruct::orderCaptures(move *m)
    return m + count;
    }
 
+
+/*
+ * Function: MovePicker
+ * Input:    The board, the arrays for the moves and the capture values, the
+ *           hash move and ALL_NON_CAP or MATE_TRIES
+ * Output:   None.
+ * Purpose:  Sets up the picker, nothing is generated yet
+ */
+
+MovePicker::MovePicker(boardStruct *b, move *m, int *v, move hash, int type)
+   {
+   board = b;
+   moves = m;
+   values = v;
+   hashMove = hash;
+   searchType = type;
+   captureCount = nextCapture = current = end = 0;
+   refutationCount = nextRefutation = 0;
+   stage = picked = PICK_HASH_MOVE;
+   }
+
+
+/*
+ * Function: setRefutations
+ * Input:    The two killers of this ply and the counter move to the last
+ *           move, any of them can be bad
+ * Output:   None.
+ * Purpose:  They come right after the captures with ALL_NON_CAP.  Nothing
+ *           is checked yet, the node might cut off before they are needed.
+ */
+
+void MovePicker::setRefutations(move *killer, move counter)
+   {
+   refutations[0] = killer[0];
+   refutations[1] = killer[1];
+   refutations[2] = counter;
+   refutationCount = 3;
+   }
+
+
+/*
+ * Function: isRefutation
+ * Input:    A quiet move
+ * Output:   1 if it was already handed out as a killer or counter move
+ * Purpose:  So the quiet moves stage skips them.  The ones that were no
+ *           good in this position were made bad and never match.
+ */
+
+int MovePicker::isRefutation(move m)
+   {
+   int i;
+
+   for (i = 0; i < nextRefutation; i++)
+      if (m == refutations[i]) return 1;
+
+   return 0;
+   }
+
+
+/*
+ * Function: selectCapture
+ * Input:    None.
+ * Output:   None.
+ * Purpose:  Brings the best capture that is left to nextCapture.  The ones
+ *           in between move up one, so captures of the same value keep
+ *           their order, the same order orderCaptures() sorts them in.
+ */
+
+void MovePicker::selectCapture()
+   {
+   int i, best = nextCapture, bestValue;
+   move bestMove;
+
+   for (i = nextCapture + 1; i < captureCount; i++)
+      if (values[i] > values[best]) best = i;
+
+   if (best == nextCapture) return;
+
+   bestMove = moves[best];
+   bestValue = values[best];
+   for (i = best; i > nextCapture; i--)
+      {
+      moves[i] = moves[i - 1];
+      values[i] = values[i - 1];
+      }
+   moves[nextCapture] = bestMove;
+   values[nextCapture] = bestValue;
+   }
+
+
+/*
+ * Function: nextMove
+ * Input:    None.
+ * Output:   The next move to search, a bad move when there are no more.
+ * Purpose:  Generates the stages as they are needed.  The captures are
+ *           picked one at a time instead of sorting them all, most nodes
+ *           cut off after the first few.  With MATE_TRIES only captures
+ *           that gain at least 20 count, as with orderCaptures().  With 
+ *           ALL_NON_CAP all captures come before the quiet moves, even 
+ *           those that lose material, they still put a piece in hand.
+ *           Trying the ones below 0 after the quiet moves made the trees
+ *           10-30% bigger.
+ */
+
+move MovePicker::nextMove()
+   {
+   move m;
+
+   for (;;)
+      {
+      switch (stage)
+         {
+         case PICK_HASH_MOVE:
+            stage = PICK_START_CAPTURES;
+            picked = PICK_HASH_MOVE;
+            if (!hashMove.isBad()) return hashMove;
+            break;
+
+         case PICK_START_CAPTURES:
+            board->captureMoves(moves);
+            captureCount = board->scoreCaptures(moves, values);
+            stage = PICK_GOOD_CAPTURES;
+            break;
+
+         case PICK_GOOD_CAPTURES:
+            if (nextCapture < captureCount)
+               {
+               selectCapture();
+               if ((searchType == ALL_NON_CAP) || (values[nextCapture] >= 20))
+                  {
+                  m = moves[nextCapture++];
+                  if (m == hashMove) break;
+                  picked = stage;
+                  return m;
+                  }
+               }
+            stage = (searchType == ALL_NON_CAP) ? PICK_KILLERS : PICK_START_MATE_TRIES;
+            break;
+
+         case PICK_KILLERS:
+            if (nextRefutation < refutationCount)
+               {
+               m = refutations[nextRefutation];
+
+               // They come from other positions.  Only quiet moves are
+               // taken, and no castling or blocked double pawn push, which
+               // badMove() would let through
+
+               if (m.isBad() || m == hashMove || isRefutation(m) ||
+                   board->pieceOnSquare(m.to()) != NONE || board->badMove(m) ||
+                   ((m.moved() == PAWN) && (m.from() != IN_HAND) &&
+                    ((file(m.from()) != file(m.to())) || (m.promotion() != NONE) ||
+                     ((abs(m.to() - m.from()) == TWO_RANKS) &&
+                      (board->pieceOnSquare((m.from() + m.to()) / 2) != NONE)))) ||
+                   ((m.moved() == KING) && (abs(m.to() - m.from()) == TWO_FILES)))
+                  refutations[nextRefutation].makeBad();
+
+               nextRefutation++;
+               if (refutations[nextRefutation - 1].isBad()) break;
+               picked = stage;
+               return m;
+               }
+            stage = PICK_START_QUIET_MOVES;
+            break;
+
+         case PICK_START_QUIET_MOVES:
+            current = captureCount;
+            end = captureCount + board->aiMoves(moves + captureCount);
+assert (end < MAX_MOVES);
+            stage = PICK_QUIET_MOVES;
+            break;
+
+         case PICK_QUIET_MOVES:
+            if (current < end)
+               {
+               m = moves[current++];
+               if ((m == hashMove) || isRefutation(m)) break;
+               picked = stage;
+               return m;
+               }
+            stage = PICK_DONE;
+            break;
+
+         case PICK_START_MATE_TRIES:
+            current = captureCount;
+            end = captureCount + board->mateTries(moves + captureCount);
+assert (end < MAX_MOVES);
+            stage = PICK_MATE_TRIES;
+            break;
+
+         case PICK_MATE_TRIES:
+            if (current < end)
+               {
+               m = moves[current++];
+               if (m == hashMove) break;
+               picked = stage;
+               return m;
+               }
+            stage = PICK_DONE;
+            break;
+
+         default:
+            m.makeBad();
+            return m;
+         }
+      }
+   }
+
+
+/*
+ * Function: moveType
+ * Input:    None.
+ * Output:   The move generation type of the last move handed out.
+ * Purpose:  For the DEBUG_STATS make/unmake counts
+ */
+
+int MovePicker::moveType()
+   {
+   switch (picked)
+      {
+      case PICK_HASH_MOVE: return HASH_MOVE;
+      case PICK_GOOD_CAPTURES: return (searchType == ALL_NON_CAP) ? ALL_CAP : WINNING_CAP;
+      case PICK_KILLERS:
+      case PICK_QUIET_MOVES: return ALL_NON_CAP;
+      case PICK_MATE_TRIES: return MATE_TRIES;
+      default: return ALL_CAP;
+      }
+   }
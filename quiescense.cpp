@@ -33,23 +33,12 @@
 #ifdef GAMETREE
 	extern char filename[MAX_STRING][DEPTH_LIMIT]; 
 	extern FILE *fi[DEPTH_LIMIT];
-	extern int currentDepth;
 #endif
 
-extern int stats_quiescensePositionsSearched;  
-extern volatile int stopThinking;        
-
-
-/* Get a place to store the moves.  They used to 
-   be in a local array, but that blew up the stack */
-
-
-extern move searchMoves[DEPTH_LIMIT][MAX_MOVES]; 
-
 
 /*
  * Function: quiesce
- * Input:    alpha, beta and the current ply
+ * Input:    the search context, alpha, beta and the current ply
  * Output:   None
  * Purpose:  Uses an recursive alpha-beta quiescense search to assign a value 
  *           to the position.  For each position it uses either the current
@@ -58,7 +47,7 @@ extern move searchMoves[DEPTH_LIMIT][MAX_MOVES];
  *           deeper than MAX_QUIESCE_SEARCH_DEPTH
  */
 
-int quiesce(int alpha, int beta, int ply)
+int quiesce(SearchContext *sc, int alpha, int beta, int ply)
    {
    int best, value;
    move *end, *current, *m;   
@@ -75,26 +64,26 @@ assert (ply <= DEPTH_LIMIT);
   int n;
   
 
-  if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+  if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
   {
   tree_positionsSaved++;
   sprintf(filename[ply],"=");
   sprintf(buf2,"Moves:");
   for (n=0; n<ply; n++) 
   {
-	  DBMoveToRawAlgebraicMove(AIBoard.getMoveHistory(n), buf); 
+	  DBMoveToRawAlgebraicMove(sc->AIBoard.getMoveHistory(n), buf); 
 	  strcat(filename[ply],buf);
 	  strcat(buf2," "); strcat(buf2,buf);  
 
   }
-  sprintf(buf3,"treemoves/%s-%d.html",filename[ply],currentDepth);
+  sprintf(buf3,"treemoves/%s-%d.html",filename[ply],sc->currentDepth);
   fi[ply] = fopen(buf3,"wt");
 
   fprintf(fi[ply],"<link rel=\"stylesheet\" href=\"../style/style.css\" type=\"text/css\">\n");
   fprintf(fi[ply],"<html><table cellpadding=10><tr><td valign=top>\n"); 
 
   
-  printHtmlBoard(fi[ply]); 
+  printHtmlBoard(fi[ply], sc->AIBoard); 
   fprintf(fi[ply],"</td><td valign=top>\n"); 
   
   fprintf(fi[ply],"%s <br><br><hr><br>", buf2);
@@ -103,24 +92,24 @@ assert (ply <= DEPTH_LIMIT);
 
 #endif  
 
-   if (stopThinking)
+   if (sc->stopThinking)
    {
       
 #ifdef GAMETREE
-	 if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+	 if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 	 {
 		fprintf(fi[ply],"<br>Return: out of time<br>\n");
 		fclose(fi[ply]); 
 	 }
 #endif
-	 return AIBoard.eval();
+	 return sc->AIBoard.eval();
    }
 
 
-   if (AIBoard.isInCheck(AIBoard.getColorOffMove()))
+   if (sc->AIBoard.isInCheck(sc->AIBoard.getColorOffMove()))
    {
 #ifdef GAMETREE
-	if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+	if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 	{	
 		fprintf(fi[ply],"<br>Return: Illegal Position: other side in check<br></td></tr></table></html>\n");
 		fclose(fi[ply]); 
@@ -131,7 +120,7 @@ assert (ply <= DEPTH_LIMIT);
    }
 
 #ifdef GAMETREE
-	if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+	if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 	{	
 	fprintf(fi[ply]," quiesce at depth %d<br><br><hr><br><br>Winning Captures:<br><br>\n", ply); 	
 	}
@@ -139,24 +128,24 @@ assert (ply <= DEPTH_LIMIT);
 
 
 
-   m = searchMoves[ply];
+   m = sc->searchMoves[ply];
   
-   if (ply >= MAX_QUIESCE_SEARCH_DEPTH || (AIBoard.captureMoves(m)) == 0)
+   if (ply >= MAX_QUIESCE_SEARCH_DEPTH || (sc->AIBoard.captureMoves(m)) == 0)
    {
 #ifdef GAMETREE
-	if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+	if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 	{
 		fprintf(fi[ply],"<br>Return: no more captures or max depth<br></td></tr></table></html>\n");
 		fclose(fi[ply]); }
 #endif 
-      return AIBoard.eval();
+      return sc->AIBoard.lazyEval(alpha, beta);
    }
 
-   stats_quiescensePositionsSearched++;
+   sc->stats_quiescensePositionsSearched++;
       
-   best = AIBoard.eval(); 	
+   best = sc->AIBoard.lazyEval(alpha, beta); 	
 
-   end = AIBoard.orderCaptures(m);
+   end = sc->AIBoard.orderCaptures(m);
 
    for (current = m; current < end; current++)
       {
@@ -165,11 +154,11 @@ assert (ply <= DEPTH_LIMIT);
 
 	   if (best > alpha) alpha = best;
 
-assert (!AIBoard.badMove(*current));  
+assert (!sc->AIBoard.badMove(*current));  
 
-		AIBoard.changeBoard(*current);
-		value = -quiesce(-beta, -alpha, ply + 1);
-		AIBoard.unchangeBoard();	
+		sc->AIBoard.changeBoard(*current);
+		value = -quiesce(sc, -beta, -alpha, ply + 1);
+		sc->AIBoard.unchangeBoard();	
 
 assert (value >= -INFINITY);
 assert (value <= INFINITY); 
@@ -178,11 +167,11 @@ assert (value <= INFINITY);
 #ifdef GAMETREE
 			char buf[MAX_STRING], buf2[MAX_STRING], buf3[MAX_STRING];  
 		
-			if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+			if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 			{								
 				DBMoveToRawAlgebraicMove(*current, buf);
 				strcpy(buf2, filename[ply]); strcat(buf2, buf);
-				sprintf (buf3,"<a href=\"%s-%d.html\">%s</a>  Return Value: %d<br>\n",buf2,currentDepth, buf,value); 				
+				sprintf (buf3,"<a href=\"%s-%d.html\">%s</a>  Return Value: %d<br>\n",buf2,sc->currentDepth, buf,value); 				
 				fprintf (fi[ply], buf3); 
 			}
 #endif		
@@ -197,7 +186,7 @@ assert (value <= INFINITY);
 
    
 #ifdef GAMETREE
-	if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+	if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 	{
 		fprintf(fi[ply],"<br><br><hr><br>Return: end of quiesce<br></td></tr></table></html>\n");
 		fclose(fi[ply]); 
@@ -28,6 +28,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#undef INFINITY					/* brain.h has its own */
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#endif
 
 #include "board.h"
 #include "brain.h"
@@ -36,46 +42,49 @@
 #include "interface.h"
 
 
-PrincipalVariation pv;					/* The principal variation, there needs
-                                         to be a separate one for each ply that
-                                         is searched */
+/* Everything the search changes while it runs lives in a SearchContext (see
+   brain.h), so that with CORES > 1 every helper thread searches on its own
+   board with its own move stacks and PV.  Only the transposition table is
+   shared. */
 
-move searchMoves[DEPTH_LIMIT][MAX_MOVES]; /* Where to store the moves.  They
-                                             used to be in a local array, but
-                                             that blew up the stack */
-boardStruct AIBoard;                 /* The board that the AI uses */
-volatile int stopThinking;           /* If the search should be stopped */
+SearchContext mainSearch;                /* The context of the main search */
 volatile int reSearch;               /* If the search should be restarted */
 volatile int forceMove;              /* Make a move, even if you get mated*/
 double millisecondsPerMove;             /* How many millisecs to take on a move */
-int stats_positionsSearched;               /* # of search() done */
-int stats_quiescensePositionsSearched;     /* # of quieses() done */
-int stats_transpositionHits;               /* # of success for transposition lookups*/
 int stats_hashFillingUp; 
-int stats_hashSize;
+qword stats_hashSize;
 
 
 const int FractionalDeep[MAX_SEARCH_DEPTH + 1] = { 0, 0, ONE_PLY, ONE_PLY * 2, ONE_PLY * 3, ONE_PLY * 4, ONE_PLY * 5, ONE_PLY * 6, 26, 28, 30, 32, 34, 36, 38, 40, 42, 44, 46, 48, 50, 52, 54, 56, 58, 60, 62, 64, 66, 68, 70, 72, 74, 76, 78, 80, 82, 84, 86, 88, 999 };
 		/* The implementation allows to experiment with fractional deepening, for example smaller steps at higher depths*/
 
+/* Half the width of the first aspiration window at the root, it doubles on
+   every fail high or low */
 
+#define ASPIRATION_WINDOW 40
 
-int initialTime;
-int currentDepth; 
-int movesSearched;
+int lmrReductions[2][LMR_DEPTHS][LMR_MOVES];
+		/* How many fractional plies a quiet move is reduced by, for board
+		   moves and drops, by the depth in plies and the number of moves
+		   searched at the node */
 
 
 
+int initialTime;
 
-#ifdef DEBUG_STATS
 
-int stats_forceext, stats_checkext, stats_capext;  
-int stats_NullTries[DEPTH_LIMIT], stats_NullCuts[DEPTH_LIMIT]; 
-int stats_RazorTries, stats_Razors; 
-int stats_MakeUnmake[MOVEGEN_TYPES]; 
+/* Lazy SMP: the helper threads search the same root position as the main
+   thread, just with a different root move order and every second one a ply
+   deeper.  They only help by filling the shared transposition table.  */
+
+SearchContext *helperContexts[MAX_THREADS]; /* Allocated the first time a helper runs */
+int helpersRunning;                     /* How many helpers are searching */
 
+#ifndef __EMSCRIPTEN__
+std::thread helperThreads[MAX_THREADS];
 #endif
 
+
 /* Time */
 clock_t startClockply, endClockply, startClockAnalyze; 
 clock_t startClockTime, endClockTime; 
@@ -102,15 +111,15 @@ int tryToPonder;						/* If we should be pondering */
  */
 
 
-__forceinline void savePrincipalVar(move m, int ply) 
+__forceinline void savePrincipalVar(SearchContext *sc, move m, int ply) 
 {
 	
-assert ( pv.depth[ply] <= DEPTH_LIMIT );
+assert ( sc->pv.depth[ply] <= DEPTH_LIMIT );
 
 
-    pv.moves[ply-1][0] = m;
-    for(int i = 0; i < pv.depth[ply]; i++) pv.moves[ply-1][i + 1] = pv.moves[ply][i];
-    pv.depth[ply-1] = pv.depth[ply] + 1;
+    sc->pv.moves[ply-1][0] = m;
+    for(int i = 0; i < sc->pv.depth[ply]; i++) sc->pv.moves[ply-1][i + 1] = sc->pv.moves[ply][i];
+    sc->pv.depth[ply-1] = sc->pv.depth[ply] + 1;
 
 }
 
@@ -123,7 +132,7 @@ assert ( pv.depth[ply] <= DEPTH_LIMIT );
 * Purpose:  Used to print out information about the principal variation.
 */
 
-static void printPrincipalVar(int valueReached)
+static void printPrincipalVar(SearchContext *sc, int valueReached)
 {
 	int n, timeUsed;
 	int variationLength = 0;
@@ -156,17 +165,17 @@ static void printPrincipalVar(int valueReached)
 
 	strcpy(pvtxt, "");
 
-	for (n = 0; n < pv.depth[0]; n++)
+	for (n = 0; n < sc->pv.depth[0]; n++)
 	{
-		assert(!AIBoard.badMove(pv.moves[0][n]));
+		assert(!sc->AIBoard.badMove(sc->pv.moves[0][n]));
 
-		AIBoard.changeBoard(pv.moves[0][n]); 
+		sc->AIBoard.changeBoard(sc->pv.moves[0][n]); 
 		variationLength++;
 
-		DBMoveToRawAlgebraicMove(pv.moves[0][n], buf);
+		DBMoveToRawAlgebraicMove(sc->pv.moves[0][n], buf);
 		strcat(pvtxt, buf); strcat(pvtxt, " ");
 
-		if (AIBoard.isNotRepDrawSearch()) // print the valuation only up to the first repetition
+		if (sc->AIBoard.isNotRepDrawSearch()) // print the valuation only up to the first repetition
 		{
 			break;
 		}
@@ -174,8 +183,8 @@ static void printPrincipalVar(int valueReached)
 
 	if (!xboardMode) 
 	{
-		sprintf(buf, "%3d  %6d  %5d %8d ", currentDepth, valueReached,
-			timeUsed, stats_positionsSearched);
+		sprintf(buf, "%3d  %6d  %5d %8d ", sc->currentDepth, valueReached,
+			timeUsed, sc->stats_positionsSearched);
 
 		for (n = variationLength; n < 9; n++)
 		{
@@ -189,18 +198,18 @@ static void printPrincipalVar(int valueReached)
 	}
 	else 
 	{ // xboard mode, and not done searching yet
-		if ((timeUsed>15) || (currentDepth > 6))
+		if ((timeUsed>15) || (sc->currentDepth > 6))
 		{ // only output after first 0.15 seconds OR at least depth 6
 			sprintf(buf, "%d %d %d %d ",
-				currentDepth, valueReached,
-				timeUsed, stats_positionsSearched);
+				sc->currentDepth, valueReached,
+				timeUsed, sc->stats_positionsSearched);
 			output(buf); output(pvtxt); output("\n");
 		}
 	}
 
 	for (n = variationLength - 1; n >= 0; n--) 
 	{
-		AIBoard.unchangeBoard();
+		sc->AIBoard.unchangeBoard();
 	}
 
 	startClockply = getSysMilliSecs();
@@ -218,31 +227,32 @@ void analyzeUpdate()
 
 {
 	char buf[MAX_STRING], buf2[MAX_STRING];
+	SearchContext *sc = &mainSearch;
 
 	if (xboardMode)
 	{
-		if (!searchMoves[0][movesSearched].isBad())
+		if (!sc->searchMoves[0][sc->movesSearched].isBad())
 		{
-			DBMoveToRawAlgebraicMove(searchMoves[0][movesSearched], buf2);
+			DBMoveToRawAlgebraicMove(sc->searchMoves[0][sc->movesSearched], buf2);
 			// the 100 is in place of "total moves" because we don't have that here
 			sprintf(buf, "stat01: %ld %d %d %d 100 %s \n",
 				(getSysMilliSecs() - startClockTime) / 10,
-				stats_positionsSearched,
-				currentDepth,
-				movesSearched, buf2);
+				sc->stats_positionsSearched,
+				sc->currentDepth,
+				sc->movesSearched, buf2);
 			output(buf);
 		}
 	}
 	else
 		if (((getSysMilliSecs() - startClockAnalyze) > 4000) && ((startClockAnalyze - startClockTime) > 200))
 		{
-			if (!searchMoves[0][movesSearched].isBad())
+			if (!sc->searchMoves[0][sc->movesSearched].isBad())
 			{
-				DBMoveToRawAlgebraicMove(searchMoves[0][movesSearched], buf2);
+				DBMoveToRawAlgebraicMove(sc->searchMoves[0][sc->movesSearched], buf2);
 				sprintf(buf,
 					"             %5ld %8d  searching: %s ..   ( HT: %2d percent )\r",
-					((getSysMilliSecs() - startClockply) / 10), stats_positionsSearched,
-					buf2, (stats_hashFillingUp * 100 / stats_hashSize));
+					((getSysMilliSecs() - startClockply) / 10), sc->stats_positionsSearched,
+					buf2, (int) (stats_hashFillingUp * (qword) 100 / stats_hashSize));
 				output(buf);
 			}
 			startClockAnalyze = getSysMilliSecs();
@@ -258,14 +268,14 @@ void analyzeUpdate()
  *           of time.
  */
 
-void calcTimeToSpend()
+void calcTimeToSpend(SearchContext *sc)
 
 {
 
 	int mytime, opptime;
 
-	mytime = AIBoard.getTime(AIBoard.getDeepBugColor());
-	opptime = AIBoard.getTime(otherColor(AIBoard.getDeepBugColor()));
+	mytime = sc->AIBoard.getTime(sc->AIBoard.getDeepBugColor());
+	opptime = sc->AIBoard.getTime(otherColor(sc->AIBoard.getDeepBugColor()));
 
 	if ((FIXED_DEPTH) || (analyzeMode))
 
@@ -304,30 +314,42 @@ void calcTimeToSpend()
  * Output:   That value of the position after the first move.
  * Purpose:  Used by searchRoot to find the value of the first move.  This
  *           is done differently then all of the other moves because it has
- *           to find and exact value.  searchFirstMove() sets alpha to be
- *           the guess and beta to be the guess + 1.  This will either fail
- *           high or low, then searchFirstMove() sees if the value of the
- *           position is a little away from the guess.  If the search fails
- *           high or low again then searchFirstMove() gets the exact value,
- *           no matter how high/low it is.
+ *           to find and exact value.  The search starts with an aspiration
+ *           window of ASPIRATION_WINDOW around the guess, the value of the
+ *           last iteration.  If it fails high or low that side of the
+ *           window is moved past the value by twice the last step and the
+ *           move searched again, until the value is inside the window or
+ *           the window is unbounded.  Without a
+ *           guess, or with a mate score, the window is unbounded right away.
  */
 
-int searchFirstMove(move m, int depth, int guess)
+int searchFirstMove(SearchContext *sc, move m, int depth, int guess)
 {
   int learnValue; 
-  int alpha, beta, value;
-
-  alpha = guess ;
-  beta = guess +1;
+  int alpha, beta, value, delta;
 
 assert (depth < MAX_SEARCH_DEPTH * ONE_PLY);
 assert (guess >= -INFINITY);
 assert (guess <= INFINITY); 
-assert (!AIBoard.badMove(m));
+assert (!sc->AIBoard.badMove(m));
+
+  delta = ASPIRATION_WINDOW;
+
+  if ((guess <= -MATE) || (guess >= MATE))
+  {
+	  alpha = -INFINITY;
+	  beta = INFINITY;
+  }
+  else
+  {
+	  alpha = guess - delta;
+	  beta = guess + delta;
+  }
 
-  AIBoard.changeBoard(m);
+  sc->AIBoard.changeBoard(m);
+  sc->AIBoard.prefetchHash();
 
-  learnValue = AIBoard.checkLearnTable(); 
+  learnValue = sc->AIBoard.checkLearnTable(); 
   
   // the idea is to play faster or slower in the opening depending on
   // whether we did well or bad in the past  in this position
@@ -335,7 +357,7 @@ assert (!AIBoard.badMove(m));
   millisecondsPerMove -= learnValue *4; 
 
 #ifdef DEBUG_LEARN
-  if ((learnValue) && (currentDepth == 4))
+  if ((learnValue) && (sc->currentDepth == 4))
   {
 	  char buf[MAX_STRING], buf2[MAX_STRING]; 
 	  DBMoveToRawAlgebraicMove(m, buf);
@@ -344,55 +366,34 @@ assert (!AIBoard.badMove(m));
   }
 #endif
 
-  
-  value = learnValue -search(-beta+ learnValue, -alpha+ learnValue, depth - ONE_PLY, 1, 0);
-
-   AIBoard.unchangeBoard();
-
-   if(stopThinking) return -INFINITY;
-
-   if(value >= beta) {   
-
-    // The null window search failed high  
-
-    alpha = value;
-    beta = INFINITY;
-
-assert (!AIBoard.badMove(m));    
-	
-	AIBoard.changeBoard(m);
-
-	// not -beta + learnValue, since -beta = -INFINITY and we can't allow that to get smaller !
-	value = learnValue -search(-beta, -alpha+learnValue, depth - ONE_PLY, 1, 0);
-
-    AIBoard.unchangeBoard();
-
-    if(stopThinking) return -INFINITY;
-
-  
-    else return value;
-  } else {
-
-    // The null window search failed low  
+  for (;;)
+  {
+	// an unbounded side stays unbounded, -INFINITY can't get smaller !
 
-    beta = value;
-    alpha = -INFINITY; 
-    
-assert (!AIBoard.badMove(m));	
-	AIBoard.changeBoard(m);
-	
-	// not -alpha + learnValue
-	value = learnValue -search(-beta+learnValue, -alpha, depth - ONE_PLY, 1, 0);
+	value = learnValue -search(sc, (beta >= INFINITY) ? -INFINITY : -beta + learnValue, (alpha <= -INFINITY) ? INFINITY : -alpha + learnValue, depth - ONE_PLY, 1, PV_NODE, 0);
 
-    AIBoard.unchangeBoard();
+	if (sc->stopThinking) break;
 
-    if(stopThinking) return -INFINITY;
-   
-    else return value;
+	if ((value <= alpha) && (alpha > -INFINITY))
+	{
+		sc->stats_aspirationFailLows[sc->currentDepth]++;
+		delta *= 2;
+		alpha = max(value - delta, -INFINITY);
+	}
+	else if ((value >= beta) && (beta < INFINITY))
+	{
+		sc->stats_aspirationFailHighs[sc->currentDepth]++;
+		delta *= 2;
+		beta = min(value + delta, INFINITY);
+	}
+	else break;
   }
 
+  sc->AIBoard.unchangeBoard();
 
+  if(sc->stopThinking) return -INFINITY;
 
+  return value;
 }
 
 /* Function: searchMove
@@ -403,12 +404,13 @@ assert (!AIBoard.badMove(m));
  *           is worse then the best one already found by setting beta
  *           to be alpha + 1.  If this move is better then it sees how
  *           much better it is, geting the exact value, no matter how high
- *           it is.  This is basically the same as searchFirstMove(),
+ *           it is, with a window above the new value that is widened
+ *           while it fails high.  This is basically the same as searchFirstMove(),
  *           except if it fails low, then it doesn't search anymore,
  *           since it already knows that there is a better move.  
  */
 
-int searchMove(move m, int depth, int alpha)
+int searchMove(SearchContext *sc, move m, int depth, int alpha)
 {
 
 #ifdef GAMETREE
@@ -417,22 +419,23 @@ char buf3[MAX_STRING];
 #endif
 	
   int learnValue, razor; 
-  int beta, value;
+  int beta, value, delta;
 
   beta = alpha +1; 
 
 assert (alpha >= -INFINITY);
 assert (alpha <= INFINITY);
 assert (depth <= MAX_SEARCH_DEPTH * ONE_PLY);  
-assert (!AIBoard.badMove(m));  
+assert (!sc->AIBoard.badMove(m));  
   
-  AIBoard.changeBoard(m);
+  sc->AIBoard.changeBoard(m);
+  sc->AIBoard.prefetchHash();
 
-  learnValue = AIBoard.checkLearnTable(); 
+  learnValue = sc->AIBoard.checkLearnTable(); 
   millisecondsPerMove -= learnValue *4; 
 
 #ifdef DEBUG_LEARN
-  if ((learnValue) && (currentDepth == 4))
+  if ((learnValue) && (sc->currentDepth == 4))
   {
 	  char buf[MAX_STRING], buf2[MAX_STRING]; 
 	  DBMoveToRawAlgebraicMove(m, buf);
@@ -446,11 +449,11 @@ assert (!AIBoard.badMove(m));
 
 
 
-	  if ( (AIBoard.isInCheck(AIBoard.getColorOnMove()))   
+	  if ( (sc->AIBoard.isInCheck(sc->AIBoard.getColorOnMove()))   
 			// a) we are checking the opp			
-			 ||  (AIBoard.highestAttacked(m.to()))
+			 ||  (sc->AIBoard.highestAttacked(m.to()))
 			// b) we are attacking something with our move thats worth more than or the same as our moved piece, or less defendet. 
-			 ||  (AIBoard.escapingAttack(m.from(), m.to())) )
+			 ||  (sc->AIBoard.escapingAttack(m.from(), m.to())) )
 			// c) we are escaping with the piece that got attacked in the move before
 
 		  // what about blocking attack ?
@@ -459,7 +462,7 @@ assert (!AIBoard.badMove(m));
 
 #ifdef GAMETREE
 	  DBMoveToRawAlgebraicMove(m, buf);
-	  sprintf (buf3,"<a href=\"=%s-%d.html\"><b>%s</b></a> <br>\n",buf, currentDepth,buf); 
+	  sprintf (buf3,"<a href=\"=%s-%d.html\"><b>%s</b></a> <br>\n",buf, sc->currentDepth,buf); 
 	  fprintf (fi[0], buf3);
 #endif
 	  }
@@ -474,40 +477,281 @@ assert (!AIBoard.badMove(m));
 
 #ifdef GAMETREE
 	  DBMoveToRawAlgebraicMove(m, buf);
-	  sprintf (buf3,"<a href=\"=%s-%d.html\">%s</a> <br>\n",buf, currentDepth,buf); 
+	  sprintf (buf3,"<a href=\"=%s-%d.html\">%s</a> <br>\n",buf, sc->currentDepth,buf); 
 	  fprintf (fi[0], buf3);
 #endif
 	  }
 
  
-  value = learnValue -search(-beta+learnValue, -alpha+learnValue, depth - ONE_PLY + razor , 1, 0);
+  value = learnValue -search(sc, -beta+learnValue, -alpha+learnValue, depth - ONE_PLY + razor , 1, CUT_NODE, 0);
 
-  AIBoard.unchangeBoard();
+  sc->AIBoard.unchangeBoard();
 
-  if(stopThinking) return -INFINITY;
+  if(sc->stopThinking) return -INFINITY;
 
   if(value < beta) return value;
 
-  // This move is better then the best so far  
+  // This move is better then the best so far, find out how much better,
+  // widening the window step by step like searchFirstMove()
 
+  delta = ASPIRATION_WINDOW;
   alpha = value;
-  beta = INFINITY;
+  beta = (value >= MATE) ? INFINITY : min(value + delta, INFINITY);
+
+assert (!sc->AIBoard.badMove(m));
+  sc->AIBoard.changeBoard(m);
+  sc->AIBoard.prefetchHash();
 
-assert (!AIBoard.badMove(m));
-  AIBoard.changeBoard(m);
+  for (;;)
+  {
+	// not -beta + learnValue, since -beta = -INFINITY and we can't allow that to get smaller !
+	value = learnValue -search(sc, (beta >= INFINITY) ? -INFINITY : -beta + learnValue, -alpha + learnValue, depth - ONE_PLY + razor, 1, PV_NODE, 0);
 
-  // not -beta + learnValue, since -beta = -INFINITY and we can't allow that to get smaller !
-  value = learnValue -search(-beta, -alpha+learnValue, depth - ONE_PLY + razor, 1, 0);
+	if ((sc->stopThinking) || (value < beta) || (beta >= INFINITY)) break;
 
-  AIBoard.unchangeBoard();
+	sc->stats_aspirationFailHighs[sc->currentDepth]++;
+	alpha = value;
+	delta *= 2;
+	beta = min(value + delta, INFINITY);
+  }
 
-  if(stopThinking) return alpha;  
+  sc->AIBoard.unchangeBoard();
+
+  if(sc->stopThinking) return alpha;  
 
 
   return value;
 }
 
 
+/* Function: initReductions
+ * Input:    None.
+ * Output:   None.
+ * Purpose:  Fills lmrReductions.  A move is reduced by LMR_BASE plus the
+ *           logarithms of depth and move number multiplied and divided by
+ *           LMR_DIVISOR, in hundredths of a ply.  Drops have their own
+ *           pair, there are a lot more of them and most are bad.
+ */
+
+void initReductions()
+{
+  int d, n;
+
+  for (d = 0; d < LMR_DEPTHS; d++)
+  {
+	  for (n = 0; n < LMR_MOVES; n++)
+	  {
+		  if (!d || !n) 
+		  {
+			  lmrReductions[0][d][n] = lmrReductions[1][d][n] = 0;
+			  continue;
+		  }
+
+		  lmrReductions[0][d][n] = (int) ((LMR_BASE + log(d) * log(n) * 10000 / max(LMR_DIVISOR, 1)) * ONE_PLY / 100);
+		  lmrReductions[1][d][n] = (int) ((LMR_DROP_BASE + log(d) * log(n) * 10000 / max(LMR_DROP_DIVISOR, 1)) * ONE_PLY / 100);
+	  }
+  }
+}
+
+
+/* Function: helperSearch
+ * Input:    The context of the helper thread, already holding the root
+ *           position, and the number of the helper.
+ * Output:   None.
+ * Purpose:  What every helper thread runs when CORES > 1.  It does its own
+ *           iterative deepening on the root position until the main thread
+ *           is done.  The root moves are rotated by the thread number and odd
+ *           helpers search one ply deeper than even ones, so that the threads
+ *           don't all search the same tree in lockstep.
+ */
+
+void helperSearch(SearchContext *sc, int id)
+{
+  int n, count, value, alpha;
+  move tmp;
+
+  count = sc->AIBoard.moves(sc->searchMoves[0]);
+
+  if (count > 1)
+  {
+	  n = id % count;
+	  tmp = sc->searchMoves[0][n];
+	  sc->searchMoves[0][n] = sc->searchMoves[0][0];
+	  sc->searchMoves[0][0] = tmp;
+  }
+
+  for (sc->currentDepth = 1 + (id & 1); sc->currentDepth < MAX_SEARCH_DEPTH; sc->currentDepth++)
+  {
+	  alpha = -INFINITY;
+
+	  for (n = 0; n < count; n++)
+	  {
+		  sc->AIBoard.changeBoard(sc->searchMoves[0][n]);
+		  sc->AIBoard.prefetchHash();
+		  value = -search(sc, -INFINITY, -alpha, FractionalDeep[sc->currentDepth] - ONE_PLY, 1, PV_NODE, 0);
+		  sc->AIBoard.unchangeBoard();
+
+		  if (sc->stopThinking) break;
+
+		  // keep the best move first, it is the one to search first next time
+
+		  if (value > alpha)
+		  {
+			  alpha = value;
+			  tmp = sc->searchMoves[0][n];
+			  sc->searchMoves[0][n] = sc->searchMoves[0][0];
+			  sc->searchMoves[0][0] = tmp;
+		  }
+	  }
+
+	  if (sc->stopThinking) break;
+  }
+
+  saveEvalStats(&sc->stats_eval);
+}
+
+
+/* Function: startHelperThreads
+ * Input:    The context of the main search.
+ * Output:   None.
+ * Purpose:  Starts CORES - 1 helper threads on the position in sc->AIBoard.
+ *           Every helper gets its own context with a copy of the board.
+ */
+
+void startHelperThreads(SearchContext *sc)
+{
+#ifndef __EMSCRIPTEN__
+
+  int n;
+  SearchContext *helper;
+
+  helpersRunning = min(CORES, MAX_THREADS) - 1;
+
+  for (n = 1; n <= helpersRunning; n++)
+  {
+	  if (helperContexts[n] == NULL) helperContexts[n] = new SearchContext;
+	  helper = helperContexts[n];
+
+	  sc->AIBoard.copy(&helper->AIBoard);
+	  helper->AIBoard.setCheckHistory(0);
+	  helper->AIBoard.setBestCapture();
+
+	  helper->threadNumber = n;
+	  helper->stopThinking = 0;
+	  helper->stats_positionsSearched = 0;
+	  helper->stats_quiescensePositionsSearched = 0;
+	  helper->stats_transpositionHits = 0;
+	  helper->stats_cutoffs = helper->stats_firstMoveCutoffs = 0;
+	  helper->stats_pvsTries = helper->stats_pvsReSearches = 0;
+	  helper->stats_lmrTries = helper->stats_lmrReSearches = 0;
+	  memset(&helper->stats_eval, 0, sizeof(evalStats));
+	  clearRefutations(helper);
+
+	  helperThreads[n] = std::thread(helperSearch, helper, n);
+  }
+
+  // helpers left over from a search with more cores don't count anymore
+
+  for (; n < MAX_THREADS; n++)
+  {
+	  if (helperContexts[n] == NULL) continue;
+
+	  helperContexts[n]->stats_positionsSearched = 0;
+	  helperContexts[n]->stats_quiescensePositionsSearched = 0;
+	  memset(&helperContexts[n]->stats_eval, 0, sizeof(evalStats));
+  }
+
+#endif
+}
+
+
+/* Function: stopHelperThreads
+ * Input:    None.
+ * Output:   None.
+ * Purpose:  Stops the helper threads and waits for them to finish.  Has to
+ *           be called before anything they use, like the transposition table,
+ *           is changed.
+ */
+
+void stopHelperThreads()
+{
+#ifndef __EMSCRIPTEN__
+
+  int n;
+
+  if (!helpersRunning) return;
+
+  for (n = 1; n <= helpersRunning; n++)
+  {
+	  helperContexts[n]->stopThinking = 1;
+  }
+
+  for (n = 1; n <= helpersRunning; n++)
+  {
+	  helperThreads[n].join();
+  }
+
+  helpersRunning = 0;
+
+#endif
+}
+
+
+/* Function: allThreadsNodes
+ * Input:    The context of the main search and where to put the search()
+ *           and quiesce() calls done.
+ * Output:   None.
+ * Purpose:  Adds up the node counts of the main thread and all helpers that
+ *           took part in the last search, used to report the combined NPS.
+ */
+
+void allThreadsNodes(SearchContext *sc, long *searches, long *quiesces)
+{
+  int n;
+
+  *searches = sc->stats_positionsSearched;
+  *quiesces = sc->stats_quiescensePositionsSearched;
+
+  for (n = 1; n < MAX_THREADS; n++) 
+  {
+	  if (helperContexts[n] == NULL) continue;
+
+	  *searches += helperContexts[n]->stats_positionsSearched;
+	  *quiesces += helperContexts[n]->stats_quiescensePositionsSearched;
+  }
+}
+
+
+/* Function: allThreadsEvalStats
+ * Input:    The context of the main search and where to put the sums.
+ * Output:   None.
+ * Purpose:  Adds up the eval stats of the main thread and all helpers that
+ *           took part in the last search, like allThreadsNodes().
+ */
+
+void allThreadsEvalStats(SearchContext *sc, evalStats *total)
+{
+  int n;
+
+  saveEvalStats(&sc->stats_eval);
+  *total = sc->stats_eval;
+
+  for (n = 1; n < MAX_THREADS; n++) 
+  {
+	  if (helperContexts[n] == NULL) continue;
+
+	  total->evalCacheProbes += helperContexts[n]->stats_eval.evalCacheProbes;
+	  total->evalCacheHits += helperContexts[n]->stats_eval.evalCacheHits;
+	  total->kingSafetyProbes += helperContexts[n]->stats_eval.kingSafetyProbes;
+	  total->kingSafetyHits += helperContexts[n]->stats_eval.kingSafetyHits;
+	  total->lazyEvalTries += helperContexts[n]->stats_eval.lazyEvalTries;
+	  total->lazyEvalCuts += helperContexts[n]->stats_eval.lazyEvalCuts;
+	  total->pawnHashProbes += helperContexts[n]->stats_eval.pawnHashProbes;
+	  total->pawnHashHits += helperContexts[n]->stats_eval.pawnHashHits;
+  }
+}
+
+
 
 /* Function: searchRoot
  * Input:    How many ply to search and a pointer to a move to fill with the
@@ -519,7 +763,7 @@ assert (!AIBoard.badMove(m));
  *           gets to the maximum depth.
  */
 
-void searchRoot(int depth, move *rightMove, int *bestValue )
+void searchRoot(SearchContext *sc, int depth, move *rightMove, int *bestValue )
 {
     
   int n, done;				/* needed for sorting moves */
@@ -532,7 +776,8 @@ void searchRoot(int depth, move *rightMove, int *bestValue )
   char buf[MAX_STRING];
   
 
-  transpositionEntry *te;
+  transpositionEntry hashEntry, *te;
+  evalStats evalTotal;
 
   startClockTime = getSysMilliSecs();
   startClockply = getSysMilliSecs();
@@ -546,56 +791,59 @@ void searchRoot(int depth, move *rightMove, int *bestValue )
   searchedFirstMove = 0; 
   startDepth = 1;
 
-  AIBoard.setCheckHistory(0);
-  AIBoard.setBestCapture();
+  sc->AIBoard.setCheckHistory(0);
+  sc->AIBoard.setBestCapture();
  
-  count = AIBoard.moves(searchMoves[0]);  
+  count = sc->AIBoard.moves(sc->searchMoves[0]);  
   
 				// if there is only 1 legal move play it
   if ((count == 1) && (currentRules == CRAZYHOUSE) &&  (!analyzeMode)) 
   {
-    *rightMove = searchMoves[0][0];
+    *rightMove = sc->searchMoves[0][0];
     return;
   }
   if (count == 0) 
   {
-	movesSearched = 0;
-	searchMoves[0][0].makeBad(); 
-	*rightMove = searchMoves[0][0];
+	sc->movesSearched = 0;
+	sc->searchMoves[0][0].makeBad(); 
+	*rightMove = sc->searchMoves[0][0];
 	output("  0 -32000       0        0  #-0   \n");
 	waitForInput();
 	return; 
   }
  
-  if((te = AIBoard.lookup()) != NULL) { // We've searched this position before
+  if((te = sc->AIBoard.lookup(&hashEntry)) != NULL) { // We've searched this position before
                                         // and can remember some information
                                         // about it 
-    stats_transpositionHits++;
+    sc->stats_transpositionHits++;
+
+
+    // the hash move might be of another position with the same key bits 
+    // that happens to fit this one, so it has to be in our moves
 
+    for (n = 0; n < count && !te->hashMove.isBad(); n++)
+	{
+		if (sc->searchMoves[0][n] == te->hashMove) break;
+	}
 
-    if(te->type == EXACT && !te->hashMove.isBad()) {
+    if(te->type == EXACT && !te->hashMove.isBad() && n < count) {
    	  *rightMove = te->hashMove;
 	  bestMoveLastPly = *rightMove;
       *bestValue = te->value;  // no adjustment for mate values needed, because this is ply 0.
 	  value = *bestValue; 
-	  pv.depth[0] = 0; pv.depth[1] = 0;
-      n = 0;
+	  sc->pv.depth[0] = 0; sc->pv.depth[1] = 0;
 	  
-	  // these 4 lines sort the hash move to the top of moves to search
-	  while(searchMoves[0][n] != te->hashMove) n++;
-      tmp = searchMoves[0][n];
-      searchMoves[0][n] = searchMoves[0][0];
-      searchMoves[0][0] = tmp;
+	  // these 3 lines sort the hash move to the top of moves to search
+      tmp = sc->searchMoves[0][n];
+      sc->searchMoves[0][n] = sc->searchMoves[0][0];
+      sc->searchMoves[0][0] = tmp;
       
 	  searchedFirstMove = 1;  
       startDepth = (te->depth / ONE_PLY) +1;
 
-assert (n <= count); // this checks that the hash move we 
-					 // got was in the moves we generated
-      
 	  sprintf(buf, "%3d  %6d      0%8d  ", startDepth, value, 0); 
 	  output(buf);
-	  DBMoveToRawAlgebraicMove(searchMoves[0][0], buf);
+	  DBMoveToRawAlgebraicMove(sc->searchMoves[0][0], buf);
 	  output(buf);
 	  output(" <already searched>\n");		
 
@@ -605,39 +853,41 @@ assert (n <= count); // this checks that the hash move we
   } 
   
 
-  calcTimeToSpend();
+  calcTimeToSpend(sc);
+
+  if (CORES > 1) startHelperThreads(sc);
 
   // do the searches with increasing ply 
 
-  for(currentDepth = startDepth;
-      currentDepth < depth || sitting; currentDepth++) {
+  for(sc->currentDepth = startDepth;
+      sc->currentDepth < depth || sitting; sc->currentDepth++) {
 
-  movesSearched = 0; 
+  sc->movesSearched = 0; 
 
 #ifdef GAMETREE
   char buf3[MAX_STRING];
 
   sprintf(filename[0],"Start");
-  sprintf(buf3,"treemoves/%s-%d.html",filename[0],currentDepth);
+  sprintf(buf3,"treemoves/%s-%d.html",filename[0],sc->currentDepth);
   fi[0] = fopen(buf3,"wt");
   fprintf(fi[0],"<link rel=\"stylesheet\" href=\"../style/style.css\" type=\"text/css\">\n");
   
   
   fprintf(fi[0],"<html><table cellpadding=10><tr><td valign=top>\n"); 
   
-  printHtmlBoard(fi[0]); 
+  printHtmlBoard(fi[0], sc->AIBoard); 
   fprintf(fi[0],"</td><td valign=top>\n");
   
 #endif
 
-  if ((currentRules == CRAZYHOUSE) && (*bestValue <= -EXTREME_EVAL) && (currentDepth > 5))
+  if ((currentRules == CRAZYHOUSE) && (*bestValue <= -EXTREME_EVAL) && (sc->currentDepth > 5))
 
   {	  
 	  millisecondsPerMove *= 2; 
   }
 
 
-  if (((gameBoard.timeToMove() && (currentDepth >= 2)) || ((FIXED_DEPTH) && (currentDepth >= FIXED_DEPTH))) && (!sitting)) 
+  if (((gameBoard.timeToMove() && (sc->currentDepth >= 2)) || ((FIXED_DEPTH) && (sc->currentDepth >= FIXED_DEPTH))) && (!sitting)) 
   { 
 	  stopThought(); 	  
 	  break;
@@ -647,13 +897,13 @@ assert (n <= count); // this checks that the hash move we
   if(!searchedFirstMove) 
   {	
 	  
-	  value = searchFirstMove(searchMoves[0][0], FractionalDeep[currentDepth], *bestValue);
+	  value = searchFirstMove(sc, sc->searchMoves[0][0], FractionalDeep[sc->currentDepth], *bestValue);
 
 	
 
 #ifdef GAMETREE
-	  DBMoveToRawAlgebraicMove(searchMoves[0][0], buf);
-	  sprintf (buf3,"<b><a href=\"=%s-%d.html\">%s</a></b>  Return Value: %d <br>\n",buf, currentDepth,buf,value); 
+	  DBMoveToRawAlgebraicMove(sc->searchMoves[0][0], buf);
+	  sprintf (buf3,"<b><a href=\"=%s-%d.html\">%s</a></b>  Return Value: %d <br>\n",buf, sc->currentDepth,buf,value); 
 	  fprintf (fi[0], buf3);
 #endif
 	
@@ -664,10 +914,10 @@ assert (n <= count); // this checks that the hash move we
 	   searchedFirstMove = 0;
   } 
 	 
-  if(stopThinking) break;
+  if(sc->stopThinking) break;
 
   *bestValue = values[0] = value;
-  *rightMove = searchMoves[0][0];
+  *rightMove = sc->searchMoves[0][0];
 
   if (value > bestValueEver)
   {
@@ -676,51 +926,51 @@ assert (n <= count); // this checks that the hash move we
   }
   
 
-  savePrincipalVar(*rightMove, 1);    
-  printPrincipalVar(*bestValue);
+  savePrincipalVar(sc, *rightMove, 1);    
+  printPrincipalVar(sc, *bestValue);
 
   /* The following doesnt do what I thought it does, but it gives good results anyway */
   
   if ((currentRules == CRAZYHOUSE) 
 	  && ((value +40) < values[1]) 
-	  && (currentDepth > 7) 
-	  && (millisecondsPerMove * 8 < gameBoard.getTime(AIBoard.getColorOnMove())) )
+	  && (sc->currentDepth > 7) 
+	  && (millisecondsPerMove * 8 < gameBoard.getTime(sc->AIBoard.getColorOnMove())) )
   {
 	  millisecondsPerMove = (millisecondsPerMove /2) * 3;
   }   
   
-  while(movesSearched < (count-1)) 
+  while(sc->movesSearched < (count-1)) 
   
   {	
-	  movesSearched++;
+	  sc->movesSearched++;
 	  
-	  value =  searchMove(searchMoves[0][movesSearched], FractionalDeep[currentDepth], *bestValue );	 	  
+	  value =  searchMove(sc, sc->searchMoves[0][sc->movesSearched], FractionalDeep[sc->currentDepth], *bestValue );	 	  
 	
-      values[movesSearched] = value;
+      values[sc->movesSearched] = value;
 
 	  // we are out of time, and are not failing high  
 
-	  if ((stopThinking) && (values[movesSearched]) == -INFINITY)
+	  if ((sc->stopThinking) && (values[sc->movesSearched]) == -INFINITY)
 		  break;
 
 	  //  We have a new best move, let's save it 
 	  
 	  if(value > (*bestValue)) 
 	  {
-			*rightMove = searchMoves[0][movesSearched];
+			*rightMove = sc->searchMoves[0][sc->movesSearched];
 			*bestValue = value ; 
-			savePrincipalVar(*rightMove, 1);
-			printPrincipalVar(*bestValue);	  
+			savePrincipalVar(sc, *rightMove, 1);
+			printPrincipalVar(sc, *bestValue);	  
 	  }
 	  // use this to print a variation for each move tried.
-	  // savePrincipalVar(searchMoves[0][movesSearched], 1);
-	  // printPrincipalVar(value);	  
+	  // savePrincipalVar(sc, sc->searchMoves[0][sc->movesSearched], 1);
+	  // printPrincipalVar(sc, value);	  
 
-	  // we are out of time, but the last move from searchMoves() 
+	  // we are out of time, but the last move from sc->searchMoves() 
 	  // is already failing high. Play that even though we dont know 
 	  // just how good it is
 
-	  if (stopThinking)
+	  if (sc->stopThinking)
 		  break;
   
   }	
@@ -731,9 +981,9 @@ assert (n <= count); // this checks that the hash move we
       done = 1;
       for(n = 0; n < count - 1; n++) {
         if(values[n + 1] > values[n]) {
-          tmp = searchMoves[0][n];
-          searchMoves[0][n] = searchMoves[0][n + 1];
-          searchMoves[0][n + 1] = tmp;
+          tmp = sc->searchMoves[0][n];
+          sc->searchMoves[0][n] = sc->searchMoves[0][n + 1];
+          sc->searchMoves[0][n + 1] = tmp;
           value = values[n];
           values[n] = values[n + 1];
           values[n + 1] = value;
@@ -746,7 +996,7 @@ assert (n <= count); // this checks that the hash move we
 
   // if we mate, are mated or have only 1 move to escape a short mate, then move now in zh.
 
-  if (stopThinking) break;
+  if (sc->stopThinking) break;
 
 
 #ifdef GAMETREE
@@ -756,6 +1006,8 @@ assert (n <= count); // this checks that the hash move we
 
 } // end of iterative deepening
 
+stopHelperThreads();
+
 if ((*bestValue <= -EXTREME_EVAL) && (! bestMoveLastPly.isBad()) && (!analyzeMode))
  
 {	// Entering swindle mode ... ;)
@@ -768,31 +1020,67 @@ if ((*bestValue <= -EXTREME_EVAL) && (! bestMoveLastPly.isBad()) && (!analyzeMod
 
   if(!reSearch && !analyzeMode && !forceMode) {
 
-   printPrincipalVar(*bestValue);   // whisper the last ply searched 
+   printPrincipalVar(sc, *bestValue);   // whisper the last ply searched 
    endClockTime = getSysMilliSecs();
 
 	output("\n");
     output("Found move: ");
     DBMoveToRawAlgebraicMove(*rightMove, buf);
     output(buf);
-    sprintf(buf," %+d fply: %d  searches: %d quiesces: %d \n            T-hits: %d T-full: %d (percent)\n", *bestValue, currentDepth - 1, stats_positionsSearched, stats_quiescensePositionsSearched, stats_transpositionHits, (stats_hashFillingUp * 100 / stats_hashSize) );
+    sprintf(buf," %+d fply: %d  searches: %d quiesces: %d \n            T-hits: %d T-full: %d (percent)\n", *bestValue, sc->currentDepth - 1, sc->stats_positionsSearched, sc->stats_quiescensePositionsSearched, sc->stats_transpositionHits, (int) (stats_hashFillingUp * (qword) 100 / stats_hashSize) );
+    output(buf);
+    allThreadsEvalStats(sc, &evalTotal);
+    sprintf(buf,"EvalCache : Hits: %d of %d (%d percent)\n", evalTotal.evalCacheHits, evalTotal.evalCacheProbes, (int) (evalTotal.evalCacheHits * (qword) 100 / max(evalTotal.evalCacheProbes, 1)));
+    output(buf);
+    sprintf(buf,"KingSafety: Hits: %d of %d (%d percent)\n", evalTotal.kingSafetyHits, evalTotal.kingSafetyProbes, (int) (evalTotal.kingSafetyHits * (qword) 100 / max(evalTotal.kingSafetyProbes, 1)));
+    output(buf);
+    sprintf(buf,"PawnHash  : Hits: %d of %d (%d percent)\n", evalTotal.pawnHashHits, evalTotal.pawnHashProbes, (int) (evalTotal.pawnHashHits * (qword) 100 / max(evalTotal.pawnHashProbes, 1)));
+    output(buf);
+    sprintf(buf,"LazyEval  : Cuts: %d of %d (%d percent)\n", evalTotal.lazyEvalCuts, evalTotal.lazyEvalTries, (int) (evalTotal.lazyEvalCuts * (qword) 100 / max(evalTotal.lazyEvalTries, 1)));
     output(buf);
+    sprintf(buf,"Cutoffs   : %d, by the first move: %d percent\n", sc->stats_cutoffs, (int) (sc->stats_firstMoveCutoffs * (qword) 100 / max(sc->stats_cutoffs, 1)));
+    output(buf);
+    sprintf(buf,"PVS       : Re-searches: %d of %d (%d percent)\n", sc->stats_pvsReSearches, sc->stats_pvsTries, (int) (sc->stats_pvsReSearches * (qword) 100 / max(sc->stats_pvsTries, 1)));
+    output(buf);
+    sprintf(buf,"LMR       : Re-searches: %d of %d (%d percent)\n", sc->stats_lmrReSearches, sc->stats_lmrTries, (int) (sc->stats_lmrReSearches * (qword) 100 / max(sc->stats_lmrTries, 1)));
+    output(buf);
+    output("Aspiration: Re-searches (fply: low/high):");
+    for (n = 0, done = 1; n <= MAX_SEARCH_DEPTH; n++)
+    {
+      if (!sc->stats_aspirationFailLows[n] && !sc->stats_aspirationFailHighs[n]) continue;
+      sprintf(buf," %d: %d/%d", n - 1, sc->stats_aspirationFailLows[n], sc->stats_aspirationFailHighs[n]);
+      output(buf);
+      done = 0;
+    }
+    output(done ? " none\n" : "\n");
 
 #ifdef DEBUG_STATS
 
-    sprintf(buf,"Extensions: C-ext: %d F-ext: %d X-ext: %d (in fractional ply)\n", stats_checkext,stats_forceext,stats_capext);
+    sprintf(buf,"LazyEval  : Wrong side of the window: %d (main thread)\n", stats_lazyEvalErrors);
+    output(buf);
+    sprintf(buf,"Extensions: C-ext: %d F-ext: %d X-ext: %d (in fractional ply)\n", sc->stats_checkext,sc->stats_forceext,sc->stats_capext);
 	output(buf);
-	sprintf(buf,"NullCuts  : depth-1: %d d-2: %d d-3: %d d-4: %d d-5: %d d-6: %d (percent)\n", (stats_NullCuts[CC_DEPTH+1] * 100 / (stats_NullTries[CC_DEPTH+1] +1)), (stats_NullCuts[CC_DEPTH+2] * 100 / (stats_NullTries[CC_DEPTH+2] +1)),(stats_NullCuts[CC_DEPTH+3] * 100 / (stats_NullTries[CC_DEPTH+3] +1)),(stats_NullCuts[CC_DEPTH+4] * 100 / (stats_NullTries[CC_DEPTH+4] +1)),(stats_NullCuts[CC_DEPTH+5] * 100 / (stats_NullTries[CC_DEPTH+5] +1)),(stats_NullCuts[CC_DEPTH+6] * 100 / (stats_NullTries[CC_DEPTH+6] +1)));
+	sprintf(buf,"NullCuts  : depth-1: %d d-2: %d d-3: %d d-4: %d d-5: %d d-6: %d (percent)\n", (sc->stats_NullCuts[CC_DEPTH+1] * 100 / (sc->stats_NullTries[CC_DEPTH+1] +1)), (sc->stats_NullCuts[CC_DEPTH+2] * 100 / (sc->stats_NullTries[CC_DEPTH+2] +1)),(sc->stats_NullCuts[CC_DEPTH+3] * 100 / (sc->stats_NullTries[CC_DEPTH+3] +1)),(sc->stats_NullCuts[CC_DEPTH+4] * 100 / (sc->stats_NullTries[CC_DEPTH+4] +1)),(sc->stats_NullCuts[CC_DEPTH+5] * 100 / (sc->stats_NullTries[CC_DEPTH+5] +1)),(sc->stats_NullCuts[CC_DEPTH+6] * 100 / (sc->stats_NullTries[CC_DEPTH+6] +1)));
 	output(buf);
-	sprintf(buf,"Razor     : Tries: %d Success: %d\n",stats_RazorTries,stats_Razors);
+	sprintf(buf,"Razor     : Tries: %d Success: %d\n",sc->stats_RazorTries,sc->stats_Razors);
 	output(buf);
-	sprintf(buf,"Make/Unm  : Hash: %d  All-Captures: %d Winning-Captures: %d \n            MateTries: %d Full: %d \n", (stats_MakeUnmake[HASH_MOVE]), (stats_MakeUnmake[ALL_CAP]), (stats_MakeUnmake[WINNING_CAP]), (stats_MakeUnmake[MATE_TRIES]), (stats_MakeUnmake[ALL_NON_CAP]) );
+	sprintf(buf,"Make/Unm  : Hash: %d  All-Captures: %d Winning-Captures: %d \n            MateTries: %d Full: %d \n", (sc->stats_MakeUnmake[HASH_MOVE]), (sc->stats_MakeUnmake[ALL_CAP]), (sc->stats_MakeUnmake[WINNING_CAP]), (sc->stats_MakeUnmake[MATE_TRIES]), (sc->stats_MakeUnmake[ALL_NON_CAP]) );
 	output(buf);
 
 #endif
 
 	sprintf(buf,"Time      : Time Alloc: %d Clock Ticks Used (in Thousands): %d\n", (int)millisecondsPerMove, (int)(endClockTime - startClockTime));    
 	output(buf); 
+
+	if (CORES > 1)
+	{
+		long searches, quiesces;
+
+		allThreadsNodes(sc, &searches, &quiesces);
+		sprintf(buf,"Threads   : %d searches: %ld quiesces: %ld nps: %ld\n", CORES, searches, quiesces, 
+			(long)((searches + quiesces) * 1000.0 / max(endClockTime - startClockTime, 1)));
+		output(buf);
+	}
 	
 #ifdef DEBUG_HASH
 	
@@ -806,7 +1094,7 @@ if ((*bestValue <= -EXTREME_EVAL) && (! bestMoveLastPly.isBad()) && (!analyzeMod
  	stats_overallticks += (int) (endClockTime - startClockTime); 	
   }  
 
-  if ((analyzeMode || forceMode) && ((currentDepth >= MAX_SEARCH_DEPTH) || ((FIXED_DEPTH) && (currentDepth >= FIXED_DEPTH))))
+  if ((analyzeMode || forceMode) && ((sc->currentDepth >= MAX_SEARCH_DEPTH) || ((FIXED_DEPTH) && (sc->currentDepth >= FIXED_DEPTH))))
   {
     waitForInput();
   }
@@ -832,39 +1120,40 @@ void ponder()
   int values[MAX_MOVES],  n, count, value, done;
   int extensions = 0;
   char buf[MAX_STRING], buf2[MAX_STRING];
+  SearchContext *sc = &mainSearch;
 
   pondering = 1;
 
-  gameBoard.copy(&AIBoard);
-  AIBoard.setCheckHistory(0);
-  AIBoard.setBestCapture();
+  gameBoard.copy(&sc->AIBoard);
+  sc->AIBoard.setCheckHistory(0);
+  sc->AIBoard.setBestCapture();
 
-  stopThinking = 0;
-  currentDepth = 1;
-  stats_hashFillingUp = stats_positionsSearched = 0;
+  sc->stopThinking = 0;
+  sc->currentDepth = 1;
+  stats_hashFillingUp = sc->stats_positionsSearched = 0;
   millisecondsPerMove = 100000000;
-  count = AIBoard.moves(m);
+  count = sc->AIBoard.moves(m);
   memset(values, 0, sizeof(values));
   startClockAnalyze = getSysMilliSecs();
 
-  while(!stopThinking && currentDepth < MAX_SEARCH_DEPTH) 
+  while(!sc->stopThinking && sc->currentDepth < MAX_SEARCH_DEPTH) 
   {
 
-	  if (currentDepth > 4 && !xboardMode)
+	  if (sc->currentDepth > 4 && !xboardMode)
 	  {
 		  DBMoveToRawAlgebraicMove(m[0], buf2);
 		  sprintf(buf, "pondering %s %6d [%2d-%2d]\n", buf2, -values[0],
-			  currentDepth, currentDepth + (extensions / ONE_PLY));
+			  sc->currentDepth, sc->currentDepth + (extensions / ONE_PLY));
 		  output(buf);
 	  }
-	  else if (currentDepth > 4) 
+	  else if (sc->currentDepth > 4) 
 	  {
 		  DBMoveToRawAlgebraicMove(m[0], buf);
 		  sprintf(buf2, "%d %d %ld %d pondering %s(hashfill %%%5.2f)\n",
-			  currentDepth, -values[0],
+			  sc->currentDepth, -values[0],
 			  (getSysMilliSecs() - startClockAnalyze) / 10,
-			  stats_positionsSearched,
-			  buf, stats_hashFillingUp * 50.0 / stats_hashSize);
+			  sc->stats_positionsSearched,
+			  buf, stats_hashFillingUp * 100.0 / stats_hashSize);
 		  output(buf2);
 	  }
 
@@ -876,13 +1165,13 @@ void ponder()
 		// Old version 
 		// This was (actually intentionally :) ) comparing the current move to the one before. If there was a 0.8 pawn gap
 		// in valuation, the current move was searched less deep. I guess extensive tests would be needed here (georg)
-		// if (n && (currentDepth > 3) && (values[n-1] > values[n]+80)) extensions -= ONE_PLY;
+		// if (n && (sc->currentDepth > 3) && (values[n-1] > values[n]+80)) extensions -= ONE_PLY;
 	  
 		// Angrims version
 		// moves that are 0.8 pawns worse than the best get searched less
 		// and if they are 1.5 pawns worse, they get even less
 		
-		if (n && (currentDepth > 3)) {
+		if (n && (sc->currentDepth > 3)) {
 			if (values[0] > values[n] + 80)
 				extensions = -ONE_PLY;
 			else if (values[0] > values[n] + 150)
@@ -890,19 +1179,20 @@ void ponder()
 		}
 		
 
-		AIBoard.changeBoard(m[n]);
+		sc->AIBoard.changeBoard(m[n]);
+		sc->AIBoard.prefetchHash();
 
-		values[n] = -search(-INFINITY, +INFINITY, FractionalDeep[currentDepth - 1] + extensions, 1, 1);
+		values[n] = -search(sc, -INFINITY, +INFINITY, FractionalDeep[sc->currentDepth - 1] + extensions, 1, PV_NODE, 1);
 
-		AIBoard.unchangeBoard();
+		sc->AIBoard.unchangeBoard();
 
-		if(stopThinking) break;
+		if(sc->stopThinking) break;
 
 	  }
 
 
     
-  if(stopThinking) break;
+  if(sc->stopThinking) break;
 
     /* Sort the moves based on the new values */
 
@@ -920,14 +1210,14 @@ void ponder()
         }
       }
     } while(!done);
-    currentDepth++;
+    sc->currentDepth++;
 
   }
   
   pondering = 0;
 
   output("\n");
-  if(currentDepth >= MAX_SEARCH_DEPTH) {
+  if(sc->currentDepth >= MAX_SEARCH_DEPTH) {
     /* we've gone as far as we can, wait for it to be our move */
     while(gameBoard.getColorOnMove() != gameBoard.getDeepBugColor())
     waitForInput();
@@ -938,27 +1228,82 @@ void ponder()
 /* |-------------| ==> |------------------|
  * |             |     | searchFirstMove  | ==> |--------|      |------------------------|
  * |             |     |------------------|     |        | ==>  | recursiveCheckEvasion  |
- * | searchRoot  |                              | search | ==>  | recursiveFullSearch ...|
+ * | searchRoot  |                              | search | ==>  | recursivePicked        |
  * |             | ==> |------------------|     |        | ==>  |------------------------|
  * |             | ==> | searchMove       | ==> |--------|          ||
  * |-------------| ... |------------------|         ^=================
  */                                                 
 
 
+/* Function: searchChild()
+ * Input:    The window, the depth and ply of the child, the type of this
+ *           node, how many moves it searched, the one just made included,
+ *           and how much to reduce the move
+ * Output:   The value of the move that was just made, for the side that
+ *           made it
+ * Purpose:  Principal variation search.  At a PV node only the first move
+ *           gets the open window.  The others are searched with a null
+ *           window just above alpha and only searched again with the open
+ *           one if they fail high, the first move is most likely the best.
+ *           Null window nodes pass the expected node type on.  A reduced
+ *           move is first searched with the null window at the reduced
+ *           depth, and again like any other move if it fails high.
+ */
+
+inline int searchChild(SearchContext *sc, int alpha, int beta, int depth, int ply, int nodeType, int searched, int reduction)
+
+{
+	int value;
+
+	if (reduction > 0)
+	{
+		sc->stats_lmrTries++;
+
+		value = -search(sc, -alpha - 1, -alpha, depth - reduction, ply, CUT_NODE, 0);
+
+		if ((value <= alpha) || (sc->stopThinking)) return value;
+
+		sc->stats_lmrReSearches++;
+	}
+
+	if (nodeType != PV_NODE)
+	{
+		return -search(sc, -beta, -alpha, depth, ply, ((nodeType == CUT_NODE) && (searched == 1)) ? ALL_NODE : CUT_NODE, 0);
+	}
+
+	if ((searched == 1) || (beta <= alpha + 1))
+	{
+		return -search(sc, -beta, -alpha, depth, ply, PV_NODE, 0);
+	}
+
+	sc->stats_pvsTries++;
+
+	value = -search(sc, -alpha - 1, -alpha, depth, ply, CUT_NODE, 0);
+
+	if ((value > alpha) && (value < beta) && (!sc->stopThinking))
+	{
+		sc->stats_pvsReSearches++;
+		value = -search(sc, -beta, -alpha, depth, ply, PV_NODE, 0);
+	}
+
+	return value;
+}
+
+
 /* Function: recursiveCheckEvasion()
  *
  *
  */
 
-inline void recursiveCheckEvasion(int *alpha, int *beta,int *bestValue, move *bestMove,int depthWithExtensions,int ply,move hashMove)
+inline void recursiveCheckEvasion(SearchContext *sc, int *alpha, int *beta,int *bestValue, move *bestMove,int depthWithExtensions,int ply,move hashMove, int nodeType)
 
 {
 
-	int n, value;
+	int n, value, searched = 0;
 	int realcount;
 	int count = 0; 
 	move *m; 
-	m = searchMoves[ply]; 
+	m = sc->searchMoves[ply]; 
 
 
 	if (!hashMove.isBad())
@@ -967,8 +1312,8 @@ inline void recursiveCheckEvasion(int *alpha, int *beta,int *bestValue, move *be
 			count = 1;
 	}
 	
-	count += AIBoard.checkEvasionCaptures(m+count); 		
-	count += AIBoard.checkEvasionOthers(m+count);			
+	count += sc->AIBoard.checkEvasionCaptures(m+count); 		
+	count += sc->AIBoard.checkEvasionOthers(m+count);			
 
 	realcount = count;
 	if (!hashMove.isBad()) realcount--;
@@ -979,7 +1324,7 @@ inline void recursiveCheckEvasion(int *alpha, int *beta,int *bestValue, move *be
 		depthWithExtensions += FORCING_EXTENSION; 
 		
 		#ifdef DEBUG_STATS
-		stats_forceext+= FORCING_EXTENSION; 
+		sc->stats_forceext+= FORCING_EXTENSION; 
 		#endif
 	}
 	else if ((realcount > 1) && (realcount < 4))
@@ -1001,25 +1346,27 @@ inline void recursiveCheckEvasion(int *alpha, int *beta,int *bestValue, move *be
 		if ((m[n] == hashMove) && (n != 0) && (!hashMove.isBad())) continue; 
 
 
-		assert (!AIBoard.badMove(m[n]));
-		AIBoard.changeBoard(m[n]);
+		assert (!sc->AIBoard.badMove(m[n]));
+		sc->AIBoard.changeBoard(m[n]);
+		sc->AIBoard.prefetchHash();
+		searched++;
 	
 		// Recursive Search call 
 	
-		value = -search(-(*beta), -(*alpha), depthWithExtensions,  ply + 1, 0);
+		value = searchChild(sc, *alpha, *beta, depthWithExtensions, ply + 1, nodeType, searched, 0);
 
-		AIBoard.unchangeBoard();	
+		sc->AIBoard.unchangeBoard();	
 	
 	
 #ifdef GAMETREE
 		
 		char buf[MAX_STRING], buf2[MAX_STRING], buf3[MAX_STRING];  
 		
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+		if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 		{
 		DBMoveToRawAlgebraicMove(m[n], buf);
 		strcpy(buf2, filename[ply]); strcat(buf2, buf);
-		sprintf (buf3,"<a href=\"%s-%d.html\"><b>%s</b></a>  Return Value: %d<br>\n",buf2,currentDepth, buf,value); 		
+		sprintf (buf3,"<a href=\"%s-%d.html\"><b>%s</b></a>  Return Value: %d<br>\n",buf2,sc->currentDepth, buf,value); 		
 		
 		fprintf (fi[ply], buf3); 
 		}
@@ -1031,7 +1378,7 @@ inline void recursiveCheckEvasion(int *alpha, int *beta,int *bestValue, move *be
 		{	
 			*bestValue = value;  
 			*bestMove = m[n];
-			savePrincipalVar(*bestMove,ply + 1);
+			savePrincipalVar(sc, *bestMove,ply + 1);
 
 		}
 	
@@ -1043,363 +1390,127 @@ inline void recursiveCheckEvasion(int *alpha, int *beta,int *bestValue, move *be
 
 }
 
-/* Function: recursiveFullSearch()
- *
- *
+/* Function: recursivePicked()
+ * Input:    The window, the best value and move so far, the depth, the ply,
+ *           the hash move, the move that led here, ALL_NON_CAP or
+ *           MATE_TRIES and the node type
+ * Output:   1 if there was a cutoff
+ * Purpose:  Searches the moves a MovePicker hands out.  With ALL_NON_CAP
+ *           the quiet moves, killers and counter move included, are reduced
+ *           by lmrReductions unless they check, attack something or escape,
+ *           everything else is searched to the full depth.
  */
 
-inline int recursiveFullSearch(int *alpha, int *beta, int *bestValue, move *bestMove, int depthWithExtensions, int  ply, move hashMove)
+int recursivePicked(SearchContext *sc, int *alpha, int *beta, int *bestValue, move *bestMove, int depthWithExtensions, int ply, move hashMove, move lastMove, int searchType, int nodeType)
 
 {
-		int n, value, count; 
-
-
-#ifdef GAMETREE
-		char buf[MAX_STRING], buf2[MAX_STRING], buf3[MAX_STRING];  
-		
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
-		{ 
-			fprintf(fi[ply],"<br>Full Search <a href=\"start.html#razor\">(*)</a>:<br><br>\n");
-		}
-#endif 
-		
-
-		move *m; 
-
-		m = searchMoves[ply]; 
-		
-		count = AIBoard.aiMoves(m); 
-
-		
-		for ( n = 0; n < count; n++)
-		{
-			
-			if ((m[n] == hashMove) && (!hashMove.isBad())) continue; 
-
-	assert (!AIBoard.badMove(m[n]));
-
-			AIBoard.changeBoard(m[n]);	
-
-			// We don't razor if
-
-			#ifdef DEBUG_STATS
-			stats_RazorTries++;
-			stats_MakeUnmake[ALL_NON_CAP]++;
-			#endif
-		
-			if ( (AIBoard.isInCheck(AIBoard.getColorOnMove()))   
-				// a) we are checking the opp
-				 ||  (AIBoard.highestAttacked(m[n].to())) 
-				// b) we are attacking something with our move thats worth more than or the same as our moved piece, or less defended. 
-				 ||  (AIBoard.escapingAttack(m[n].from(), m[n].to())) )
-				// c) we are escaping with the piece that got attacked in the move before
-			
-
-			{			
-
-				// Recursive Search call 
-				value = -search(-(*beta), -(*alpha), depthWithExtensions ,  ply + 1, 0);		
-				AIBoard.unchangeBoard();
-
-	#ifdef GAMETREE			
-		
-				if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
-				{								
-					DBMoveToRawAlgebraicMove(m[n], buf);
-					strcpy(buf2, filename[ply]); strcat(buf2, buf);
-					sprintf (buf3,"<a href=\"%s-%d.html\"><b>%s</b></a>  Return Value: %d<br>\n",buf2,currentDepth, buf,value); 				
-					fprintf (fi[ply], buf3); 
-				}
-	#endif	
-
-
-		}
-
-		else	// razor
-
-
-		{			
-			#ifdef DEBUG_STATS
-			stats_Razors++;
-			#endif
-
-
-			if (depthWithExtensions < 6 * ONE_PLY )
-				value = -search(-(*beta), -(*alpha), depthWithExtensions - 4, ply + 1, 0);
-			else if (depthWithExtensions < 8 * ONE_PLY)
-				value = -search(-(*beta), -(*alpha), depthWithExtensions - 3, ply + 1, 0);
-			else
-				value = -search(-(*beta), -(*alpha), depthWithExtensions - 2, ply + 1, 0);
-
-			
-
-			AIBoard.unchangeBoard();
-
-			#ifdef GAMETREE					
-			if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
-			{								
-				DBMoveToRawAlgebraicMove(m[n], buf);
-				strcpy(buf2, filename[ply]); strcat(buf2, buf);
-				sprintf (buf3,"<a href=\"%s-%d.html\">%s</a> Return Value: %d<br>\n",buf2,currentDepth, buf,value); 				
-				fprintf (fi[ply], buf3); 
-			}
-			#endif	
-		}
-			
-	
-			if (value > *bestValue) 
-			{		
-				*bestValue = value;  
-				*bestMove = m[n];							
-				savePrincipalVar(*bestMove, ply + 1);
-			}						
-			
-			if (*bestValue > *alpha) *alpha = *bestValue; 
-			
-
-			if (*bestValue >= *beta) return 1;			
-			
-			
-		}		
-
-return 0; 
-}
-
-//  searching all checks
-int recursiveChecks(int *alpha, int *beta, int *bestValue, move *bestMove, int depthWithExtensions, int ply, move hashMove)
-
-{
-
-	int n, value, count, captureGain;
-	move *m;
-	m = searchMoves[ply];
-	
-	value = -INFINITY;
-
-	count = AIBoard.aiMoves(m);
-
-
-
-	for (n = 0; n < count; n++)
+	MovePicker picker(&sc->AIBoard, sc->searchMoves[ply], sc->moveValues[ply], hashMove, searchType);
+	move m, counter;
+	int value, reduction, searched = 0;
 
+	if (searchType == ALL_NON_CAP)
 	{
-		if ((m[n] == hashMove) && (!hashMove.isBad())) continue;
-
-
-		assert(!AIBoard.badMove(m[n]));
-
-
-		AIBoard.changeBoard(m[n]);
-
-		if (AIBoard.isInCheck(AIBoard.getColorOnMove()))
-		{
-			value = -search(-(*beta), -(*alpha), depthWithExtensions, ply + 1, 0);
-		}
-		AIBoard.unchangeBoard();
-
-		if (value > *bestValue)
-		{
-			*bestValue = value;
-			*bestMove = m[n];
-			savePrincipalVar(*bestMove, ply + 1);
-
-		}
-
-		if (*bestValue > *alpha) *alpha = *bestValue;
-
-		if (*bestValue >= *beta) return 1;
+		if (lastMove.isBad()) counter = lastMove;
+		else counter = sc->counterMoves[sc->AIBoard.getColorOffMove()][lastMove.moved()][lastMove.to()];
 
+		picker.setRefutations(sc->killers[ply], counter);
 	}
-	return 0;
-}
-
-/* Function: recursiveSearch()
- *
- *
- */
-
-int recursiveSearch(int *alpha, int *beta,int *bestValue, move *bestMove,int depthWithExtensions,int ply,move hashMove,int  searchType)
-
-{
-
-	int n, value, count; 
-	move *m; 
-	m = searchMoves[ply]; 
-
 
 #ifdef GAMETREE
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
-		{ 
-				switch (searchType)
-				{
-					case WINNING_CAP: 
-						fprintf(fi[ply],"<br>Winning Captures:<br><br>\n");
-						break;
-					case ALL_CAP:
-						fprintf(fi[ply],"<br>All Captures:<br><br>\n");
-						break;
-					case MATE_TRIES:
-						fprintf(fi[ply],"<br>Mate Tries:<br><br>\n");
-						break;
-				}
-		}
-			
-#endif 
+	char buf[MAX_STRING], buf2[MAX_STRING], buf3[MAX_STRING];  
+#endif
 
-	switch (searchType)
-	{
-	case WINNING_CAP: 
-		count = AIBoard.captureMoves(m);		
-		count = AIBoard.orderCaptures(m)- m;    
-		break;
-	case ALL_CAP:
-		count = AIBoard.captureMoves(m);		
-		AIBoard.orderCaptures(m);
-		break;
-	case MATE_TRIES:
-		count = AIBoard.mateTries(m); 
-		break;
-	default:
-		count = 0; 
-		assert (0);
-		break; 
-	}
+	if (*bestValue >= *beta) return 1; 
 
-	
-	for(n = 0; n < count; n++) 
-	
+	while (!(m = picker.nextMove()).isBad())
 	{
-		if ((m[n] == hashMove) && (!hashMove.isBad())) continue; 
 
+assert (!sc->AIBoard.badMove(m));
+		sc->AIBoard.changeBoard(m);
+		sc->AIBoard.prefetchHash();	// the bucket loads while we decide on the reduction
+		searched++;
 
-assert (!AIBoard.badMove(m[n]));
-		AIBoard.changeBoard(m[n]);
-	
 		#ifdef DEBUG_STATS
-		stats_MakeUnmake[searchType]++;
+		sc->stats_MakeUnmake[picker.moveType()]++;
 		#endif
 
-		// Recursive Search call 
-	
-		value = -search(-(*beta), -(*alpha), depthWithExtensions,  ply + 1, 0);
+		reduction = 0;
 
-		AIBoard.unchangeBoard();	
-	
-	
-#ifdef GAMETREE
-		
-		char buf[MAX_STRING], buf2[MAX_STRING], buf3[MAX_STRING];  
-		
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+		if ((picker.picked == PICK_QUIET_MOVES) || (picker.picked == PICK_KILLERS))
 		{
-		DBMoveToRawAlgebraicMove(m[n], buf);
-		strcpy(buf2, filename[ply]); strcat(buf2, buf);
-		sprintf (buf3,"<a href=\"%s-%d.html\"><b>%s</b></a>  Return Value: %d<br>\n",buf2,currentDepth, buf,value); 		
-		
-		fprintf (fi[ply], buf3); 
-		}
-#endif			
-	
-
-		
-		if (value > *bestValue) 
-		{	
-			*bestValue = value;  
-			*bestMove = m[n];
-			savePrincipalVar(*bestMove,ply + 1);
-
-		}
-	
-		if (*bestValue > *alpha) *alpha = *bestValue; 
-	
-		if (*bestValue >= *beta) return 1; 	
-	
-	}
-	return 0; 
-}
-
-/* Function: recursiveHash()
- *
- * @georg: Better describe what this is doing with the drawing above, also clarify what "isBad" does in Relation to the hash move.
- */
+			#ifdef DEBUG_STATS
+			sc->stats_RazorTries++;
+			#endif
 
-inline int recursiveHash(int *alpha,int *beta, int *bestValue , move *bestMove,int depthWithExtensions,int ply,move  hashMove)
+			// We don't reduce if
+			// a) we are checking the opp
+			// b) we are attacking something with our move thats worth more than or the same as our moved piece, or less defended. 
+			// c) we are escaping with the piece that got attacked in the move before
 
-{
-	int value; 
+			if (!( (sc->AIBoard.isInCheck(sc->AIBoard.getColorOnMove()))   
+				 ||  (sc->AIBoard.highestAttacked(m.to())) 
+				 ||  (sc->AIBoard.escapingAttack(m.from(), m.to())) ))
+			{
+				#ifdef DEBUG_STATS
+				sc->stats_Razors++;
+				#endif
 
+				reduction = lmrReductions[m.from() == IN_HAND][min(depthWithExtensions / ONE_PLY, LMR_DEPTHS - 1)][min(searched, LMR_MOVES - 1)];
 
-	if (!hashMove.isBad())
-	
-	{
+				// less for moves that were good before and on the PV
 
-		#ifdef GAMETREE
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
-		{ 
-			fprintf(fi[ply],"<br>Hash Move:<br><br>\n");
+				if (isHistoryMove(m, sc->AIBoard.getColorOffMove())) reduction -= ONE_PLY;
+				if (nodeType == PV_NODE) reduction -= ONE_PLY;
+			}
 		}
-		#endif 
-
-
-assert (!AIBoard.badMove(hashMove));
-		AIBoard.changeBoard(hashMove);
-
 
-		#ifdef DEBUG_STATS
-		stats_MakeUnmake[HASH_MOVE]++;
-		#endif
-	
 		// Recursive Search call 
 	
-		value = -search(-(*beta), -(*alpha), depthWithExtensions,  ply + 1, 0);
+		value = searchChild(sc, *alpha, *beta, depthWithExtensions, ply + 1, nodeType, searched, reduction);
 
-		AIBoard.unchangeBoard();	
-	
+		sc->AIBoard.unchangeBoard();	
 	
 #ifdef GAMETREE
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+		if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 		{
-		char buf[MAX_STRING], buf2[MAX_STRING], buf3[MAX_STRING];  
-
-		DBMoveToRawAlgebraicMove(hashMove, buf);
+		DBMoveToRawAlgebraicMove(m, buf);
 		strcpy(buf2, filename[ply]); strcat(buf2, buf);
-		sprintf (buf3,"<a href=\"%s-%d.html\">%s</a>  Return Value: %d<br>\n",buf2,currentDepth, buf,value); 		
+		sprintf (buf3,"<a href=\"%s-%d.html\">%s</a>  Return Value: %d<br>\n",buf2,sc->currentDepth, buf,value); 		
 		fprintf (fi[ply], buf3); 
 		}
 #endif			
-	
-
 		
 		if (value > *bestValue) 
 		{	
-	
 			*bestValue = value;  
-			*bestMove = hashMove;
-			savePrincipalVar(*bestMove, ply + 1);
-
+			*bestMove = m;
+			savePrincipalVar(sc, *bestMove,ply + 1);
 		}
 	
 		if (*bestValue > *alpha) *alpha = *bestValue; 
 	
-		
-	
+		if (*bestValue >= *beta)
+		{
+			sc->stats_cutoffs++;
+			if (searched == 1) sc->stats_firstMoveCutoffs++;
+			return 1;
+		}
 	}
 
-	if (*bestValue >= *beta) return 1; 
-
-return 0; 
+	return 0; 
 }
 
 
 /* Function: search
  * Input:    alpha, beta,how far to search+ search extensions are left 
- *			 and how far we've searched currently            
+ *			 and how far we've searched currently, the node type and
+ *			 if the move before was a null move
  * Output:   None
  * Purpose:  Uses an recursive alpha-beta search to assign a value to the 
  *           position.
  */
  
-int search(int alpha, int beta, int depth, int ply, int wasNullMove)
+int search(SearchContext *sc, int alpha, int beta, int depth, int ply, int nodeType, int wasNullMove)
 {
   int orgBeta, orgAlpha;	//  set to alpha and beta since those will be adjusted 
   int extensions = -ONE_PLY; 
@@ -1410,9 +1521,9 @@ int search(int alpha, int beta, int depth, int ply, int wasNullMove)
 
 
 
-  move bestMove, hashMove;
+  move bestMove, hashMove, lastMove;
   
-  transpositionEntry *te;
+  transpositionEntry hashEntry, *te;
 
   
 assert (alpha <= INFINITY);
@@ -1432,24 +1543,24 @@ assert (ply <= DEPTH_LIMIT);
   int n;
   
 
-  if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH -1) )
+  if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH -1) )
   {
   tree_positionsSaved++;
   sprintf(filename[ply],"=");
   sprintf(buf2,"Moves:");
   for (n=0; n<ply; n++) 
   {
-	  DBMoveToRawAlgebraicMove(AIBoard.getMoveHistory(n), buf); 
+	  DBMoveToRawAlgebraicMove(sc->AIBoard.getMoveHistory(n), buf); 
 	  strcat(filename[ply],buf);
 	  strcat(buf2," "); strcat (buf2, buf); 
   }
-  sprintf(buf3,"treemoves/%s-%d.html",filename[ply],currentDepth);
+  sprintf(buf3,"treemoves/%s-%d.html",filename[ply],sc->currentDepth);
   fi[ply] = fopen(buf3,"wt");
 
   fprintf(fi[ply],"<link rel=\"stylesheet\" href=\"../style/style.css\" type=\"text/css\">\n");
   fprintf(fi[ply],"<html><table cellpadding=10><tr><td valign=top>\n"); 
   
-  printHtmlBoard(fi[ply]); 
+  printHtmlBoard(fi[ply], sc->AIBoard); 
   fprintf(fi[ply],"</td><td valign=top>\n"); 
   
   fprintf(fi[ply],"%s <br><br><hr><br>", buf2);
@@ -1458,36 +1569,39 @@ assert (ply <= DEPTH_LIMIT);
 
 #endif  
 
-  pollForInput();
-  
-  stats_positionsSearched++;
-
-  if (FIXED_NODES && (stats_positionsSearched + stats_quiescensePositionsSearched > FIXED_NODES))
+  if (!sc->threadNumber)
   {
-	  stopThought();
+	pollForInput();
+
+	if (FIXED_NODES && (sc->stats_positionsSearched + sc->stats_quiescensePositionsSearched > FIXED_NODES))
+	{
+		stopThought();
+	}
   }
+  
+  sc->stats_positionsSearched++;
 
-assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when 
+assert ( sc->stats_positionsSearched < 1000000000 );  // hoping for the day when 
 												  // this one fails :)
 
-  pv.depth[ply] = 0;
+  sc->pv.depth[ply] = 0;
 
-  if(stopThinking) { 
+  if(sc->stopThinking) { 
 					 #ifdef GAMETREE
-					 if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+					 if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 					 {
 						fprintf(fi[ply],"<br>Return: out of time<br></td></tr></table></html>\n");
 						fclose(fi[ply]); 
 					 }
 					 #endif   
 					// @georg testing needed
-					// the return value here should be irrelevant, because in the search on root level "stopThinking" is checked too
+					// the return value here should be irrelevant, because in the search on root level "sc->stopThinking" is checked too
 					// and the tree currently searched is not used.
 					return -INFINITY; }
 
-  if(AIBoard.isInCheck(AIBoard.getColorOffMove())) { 
+  if(sc->AIBoard.isInCheck(sc->AIBoard.getColorOffMove())) { 
 													#ifdef GAMETREE
-													if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+													if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 														{	
 														fprintf(fi[ply],"<br>Return: Illegal Position: other side in check<br></td></tr></table></html>\n");
 														fclose(fi[ply]); 
@@ -1503,22 +1617,22 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
   orgAlpha = alpha;
   orgBeta = beta;
   
-  if (AIBoard.isNotRepDrawSearch())
+  if (sc->AIBoard.isNotRepDrawSearch())
   {
 	  // Todo: GAMETREE_END("Draw")
-	  AIBoard.store((max(depth, 0)), bestMove, 0, orgAlpha, orgBeta, ply);
+	  sc->AIBoard.store((max(depth, 0)), bestMove, 0, orgAlpha, orgBeta, ply);
 
 	  return 0; // Repetition
   }
 
-  if ((te = AIBoard.lookup()) != NULL) 
+  if ((te = sc->AIBoard.lookup(&hashEntry)) != NULL) 
   
   { 
 					// We've searched this position before
 					// and can remember some information
 					// about it.
   
-	  stats_transpositionHits++;
+	  sc->stats_transpositionHits++;
 
     /* If we searched to the same depth before as we're aiming at now, then
        we can use the value we got last time.
@@ -1548,7 +1662,7 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 		if(te->type == EXACT) 
 		{ 
 								#ifdef GAMETREE
-								if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+								if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 									{
 									fprintf(fi[ply],"<br><br>Return: exact hash value: %d<br></td></tr></table></html>\n", HashValue);
 									fclose(fi[ply]); }
@@ -1560,7 +1674,7 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 	  {
 			if(beta <= HashValue) {
 								  #ifdef GAMETREE
-									if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+									if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 									{	
 									fprintf(fi[ply],"<br><br>Return: fail high hash value<br></td></tr></table></html>\n");
 									fclose(fi[ply]); }
@@ -1577,7 +1691,7 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 				if(HashValue <= alpha) 
 				{
 								   #ifdef GAMETREE
-										if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+										if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 										{
 										fprintf(fi[ply],"<br><br>Return: fail low hash value<br></td></tr></table></html>\n");
 										fclose(fi[ply]);  }
@@ -1597,14 +1711,18 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
      use the best move we found last time and look at it first. */
   
     hashMove = te->hashMove;
-	
 
   } else hashMove.makeBad();
 
+  // the counter moves are indexed by the move that led here, there is
+  // none after a null move
+
+  lastMove = sc->AIBoard.getLastMove();
+  if (wasNullMove) lastMove.makeBad();
 
  
 #ifdef GAMETREE
-	if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+	if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 	{	
 	fprintf(fi[ply]," depth to horizon: <font size=+2>%d</font> (%d ply) at depth %d<br><br>\n",depth + extensions, (depth + extensions) / ONE_PLY, ply); 	
 	}
@@ -1618,28 +1736,28 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
   
 	if (!wasNullMove)
 	{
-		if (AIBoard.captureExtensionCondition())
+		if (sc->AIBoard.captureExtensionCondition())
 
 		{
 		extensions += CAPTURE_EXTENSION;
 		/*
 		// Tried the following 2 versions, both worse (= unchanged)
 
-		if (depth >= (FractionalDeep[currentDepth] ) - (ONE_PLY *2))
+		if (depth >= (FractionalDeep[sc->currentDepth] ) - (ONE_PLY *2))
 		{
 			extensions += 4;
 		}
 	
-		if (ply < currentDepth / 2)
+		if (ply < sc->currentDepth / 2)
 		    extensions += 2;
 		*/
 
 #ifdef DEBUG_STATS
-		stats_capext += CAPTURE_EXTENSION;
+		sc->stats_capext += CAPTURE_EXTENSION;
 #endif
 
 #ifdef GAMETREE
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1))
+		if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1))
 		{
 			fprintf(fi[ply], "Capture extension: depth+ %d<br>\n", CAPTURE_EXTENSION);
 		}
@@ -1650,9 +1768,9 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 
   /* In check.  */
 
-  if(AIBoard.isInCheck(AIBoard.getColorOnMove())) 
+  if(sc->AIBoard.isInCheck(sc->AIBoard.getColorOnMove())) 
   {   
-	AIBoard.setCheckHistory(1);
+	sc->AIBoard.setCheckHistory(1);
 
 	if (depth > (5 * ONE_PLY))
 	{
@@ -1669,30 +1787,30 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 
 
 		#ifdef DEBUG_STATS
-		stats_checkext+= CHECK_EXTENSION; 
+		sc->stats_checkext+= CHECK_EXTENSION; 
 		#endif
 	 	
 		#ifdef GAMETREE
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1))  { fprintf(fi[ply],"Check extension: depth + %d<br><br><hr><br>\n", CHECK_EXTENSION); }
+		if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1))  { fprintf(fi[ply],"Check extension: depth + %d<br><br><hr><br>\n", CHECK_EXTENSION); }
 		#endif	 
 	
 
-	recursiveCheckEvasion(&alpha, &beta,&bestValue, &bestMove, depth+extensions, ply, hashMove); 				 
+	recursiveCheckEvasion(sc, &alpha, &beta,&bestValue, &bestMove, depth+extensions, ply, hashMove, nodeType); 				 
   } 
   
   /* Not in Check */
 
   else  
   {	  	 
-	 AIBoard.setCheckHistory(0);
-	 AIBoard.setBestCapture(); // this is probably not needed, since before this point orderCaptures has already been called. But just to be sure.
+	 sc->AIBoard.setCheckHistory(0);
+	 sc->AIBoard.setBestCapture(); // this is probably not needed, since before this point orderCaptures has already been called. But just to be sure.
 	 
 	 if ((depth < ONE_PLY) || (ply>MAX_SEARCH_DEPTH)) 
 
 	 {
 	
 #ifdef GAMETREE
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+		if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 		{ 
 			fprintf (fi[ply]," <br><br> Return: Quiesce = %d <br></td></tr></table></html>\n", bestValue); 
 			fclose(fi[ply]); 
@@ -1701,10 +1819,10 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 		
 		
 		
-		bestValue = quiesce(alpha, beta, ply); 
+		bestValue = quiesce(sc, alpha, beta, ply); 
 
 		
-		AIBoard.store(ONE_PLY-1, bestMove, bestValue, orgAlpha, orgBeta, ply);
+		sc->AIBoard.store(ONE_PLY-1, bestMove, bestValue, orgAlpha, orgBeta, ply);
 
 		return bestValue; 
 		
@@ -1725,26 +1843,27 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 	 
 		//TODO: do we really need to try nullmove if eval() is already worse than i.e. alpha?
 
-		AIBoard.makeNullMove();
+		sc->AIBoard.makeNullMove();
+		sc->AIBoard.prefetchHash();
 
-		NullValue =  -search(-beta, -beta+1, depth - ((NULL_REDUCTION +1) * ONE_PLY), ply + 1, 1);	
+		NullValue =  -search(sc, -beta, -beta+1, depth - ((NULL_REDUCTION +1) * ONE_PLY), ply + 1, ALL_NODE, 1);	
 		
 		/*
 		
 		if (NullValue < beta)
 		{
-			NullValue = -search(-beta, -beta + 1, depth - ((NULL_REDUCTION + 1) * ONE_PLY), ply + 1, 1);
+			NullValue = -search(sc, -beta, -beta + 1, depth - ((NULL_REDUCTION + 1) * ONE_PLY), ply + 1, ALL_NODE, 1);
 		}
 		*/
-		AIBoard.unmakeNullMove(); 
+		sc->AIBoard.unmakeNullMove(); 
 
 		#ifdef GAMETREE
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+		if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 		{fprintf (fi[ply]," Null Move Value : %d <br><br>\n", NullValue); }
 		#endif
 		
 		#ifdef DEBUG_STATS
-		stats_NullTries[depth/ONE_PLY]++;   	
+		sc->stats_NullTries[depth/ONE_PLY]++;   	
 		#endif
 	
 
@@ -1753,16 +1872,16 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 		{			                     
        
 			#ifdef GAMETREE
-			if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+			if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 			{ fprintf(fi[ply],"<br><br>Return: Null Move Cut<br></td></td></tr></table></html>\n");
 			fclose(fi[ply]); }
 			#endif
 	 
 			#ifdef DEBUG_STATS
-			stats_NullCuts[depth/ONE_PLY]++;		
+			sc->stats_NullCuts[depth/ONE_PLY]++;		
 			#endif
 			
-			AIBoard.store((max (depth, 0)), bestMove, NullValue, orgAlpha, orgBeta, ply);
+			sc->AIBoard.store((max (depth, 0)), bestMove, NullValue, orgAlpha, orgBeta, ply);
 
 			return NullValue;
 
@@ -1772,14 +1891,12 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 	}	// End of NullMove try
 
 #ifdef GAMETREE
-	if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+	if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 	{ fprintf(fi[ply],"<br><hr><br>\n"); }
 #endif
 
 
-	if ( (! recursiveHash(&alpha, &beta,&bestValue, &bestMove, depth+extensions, ply, hashMove)) && 
-		 (! recursiveSearch(&alpha, &beta,&bestValue, &bestMove, depth+extensions, ply, hashMove, ALL_CAP)) )
-		 recursiveFullSearch(&alpha, &beta,&bestValue, &bestMove, depth+extensions, ply, hashMove); 
+	recursivePicked(sc, &alpha, &beta, &bestValue, &bestMove, depth+extensions, ply, hashMove, lastMove, ALL_NON_CAP, nodeType); 
 	
 
 
@@ -1795,15 +1912,15 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 			 */
 
 			// This needs further testing
-			// if ((wasNullMove) || (AIBoard.standpatCondition()))
+			// if ((wasNullMove) || (sc->AIBoard.standpatCondition()))
 			// {
 				
-				Currenteval = AIBoard.eval() ; 
+				Currenteval = sc->AIBoard.eval() ; 
 				bestValue = Currenteval; 
 				if (bestValue > alpha) alpha = bestValue; 
 
 #ifdef GAMETREE
-				if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+				if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 				{ 
 					fprintf (fi[ply],"Standpat allowed<a href=\"start.html#standpat\">(*)</a> : bestValue  = %d <br><br><hr><br>\n", bestValue); 
 				}
@@ -1813,12 +1930,12 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 				{
 				
 					#ifdef GAMETREE
-					if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+					if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 					{ fprintf(fi[ply],"<br><br><hr><br>Return:  bestValue > beta<br></td></td></tr></table></html>\n");
 					fclose(fi[ply]); }
 					#endif
 
-					AIBoard.store((max (depth, 0)), bestMove, bestValue, orgAlpha, orgBeta, ply);
+					sc->AIBoard.store((max (depth, 0)), bestMove, bestValue, orgAlpha, orgBeta, ply);
 										
 
 					return bestValue; 
@@ -1836,7 +1953,7 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 
 
 #ifdef GAMETREE
-		if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+		if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
 		{ 
 			fprintf (fi[ply],"Standpat not allowed<a href=\"start.html#standpat\">(*)</a> : bestValue  = %d <br><br><hr><br>\n", bestValue); 
 		}
@@ -1847,9 +1964,7 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
 			*/
 
 		
-			if ((!recursiveHash(&alpha, &beta, &bestValue, &bestMove, depth + extensions, ply, hashMove)) &&
-				(!recursiveSearch(&alpha, &beta, &bestValue, &bestMove, depth + extensions, ply, hashMove, WINNING_CAP)))
-				recursiveSearch(&alpha, &beta, &bestValue, &bestMove, depth + extensions, ply, hashMove, MATE_TRIES);
+			recursivePicked(sc, &alpha, &beta, &bestValue, &bestMove, depth + extensions, ply, hashMove, lastMove, MATE_TRIES, nodeType);
 				
 		} // End of <= depth * CC_DEPTH left
 
@@ -1868,9 +1983,9 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
      } 
 	 else // current rules = bughouse
 	 {
-		 if (AIBoard.cantBlock())
+		 if (sc->AIBoard.cantBlock())
 		 {
-			 bestValue = -MATE_IN_ONE + AIBoard.bughouseMateEval();
+			 bestValue = -MATE_IN_ONE + sc->AIBoard.bughouseMateEval();
 		 }
 		 else
 		 {
@@ -1884,23 +1999,30 @@ assert ( stats_positionsSearched < 1000000000 );  // hoping for the day when
   /* Now that the search is over, save information to transposition tables */
 
    
-  if (!stopThinking)
+  if (!sc->stopThinking)
   {
 	
-	AIBoard.store((max (depth, 0)), bestMove, bestValue, orgAlpha, orgBeta, ply);	
+	sc->AIBoard.store((max (depth, 0)), bestMove, bestValue, orgAlpha, orgBeta, ply);	
 
 	if (! bestMove.isBad())
 	{
 	
-		if  (AIBoard.pieceOnSquare(bestMove.to()) == NONE) 
+		// the history is shared, only the main thread updates it
+
+		if  ((sc->AIBoard.pieceOnSquare(bestMove.to()) == NONE) && (!sc->threadNumber))
+		{
+			updateHistory(bestMove, (max (depth, 0)), sc->AIBoard.getColorOnMove()); 
+		}
+
+		if  ((bestValue >= orgBeta) && (sc->AIBoard.pieceOnSquare(bestMove.to()) == NONE) && (bestMove.promotion() == NONE))
 		{
-			updateHistory(bestMove, (max (depth, 0))); 
+			storeRefutation(sc, bestMove, lastMove, ply);
 		}
 	}
 
   } 
 #ifdef GAMETREE
-  if ((tree_positionsSaved < GAMETREE) && (currentDepth == FIXED_DEPTH - 1)) 
+  if ((tree_positionsSaved < GAMETREE) && (sc->currentDepth == FIXED_DEPTH - 1)) 
   {				
 	fprintf(fi[ply],"<br><br><hr><br>Return: end of search<br></td></tr></table></html>\n");
 	fclose(fi[ply]); 
@@ -1924,21 +2046,37 @@ void findMove(move *rightMove)
   
   char buf[MAX_STRING];
   char buf2[MAX_STRING];
+  SearchContext *sc = &mainSearch;
 
   pondering = 0;
 
 
   
-  stats_overallsearches += stats_positionsSearched; stats_overallqsearches += stats_quiescensePositionsSearched;
-  stats_hashFillingUp = stats_transpositionHits = stats_quiescensePositionsSearched = stats_positionsSearched = 0; 
+  stats_overallsearches += sc->stats_positionsSearched; stats_overallqsearches += sc->stats_quiescensePositionsSearched;
+  stats_hashFillingUp = sc->stats_transpositionHits = sc->stats_quiescensePositionsSearched = sc->stats_positionsSearched = 0; 
+  stats_evalCacheHits = stats_evalCacheProbes = 0;
+  stats_kingSafetyHits = stats_kingSafetyProbes = 0;
+  stats_lazyEvalCuts = stats_lazyEvalTries = 0;
+  stats_pawnHashHits = stats_pawnHashProbes = 0;
+  sc->stats_cutoffs = sc->stats_firstMoveCutoffs = 0;
+  sc->stats_pvsTries = sc->stats_pvsReSearches = 0;
+  sc->stats_lmrTries = sc->stats_lmrReSearches = 0;
+
+  int n;
+
+  for (n = 0; n <= MAX_SEARCH_DEPTH; n++) { sc->stats_aspirationFailLows[n] = sc->stats_aspirationFailHighs[n] = 0; }
+
+  clearRefutations(sc);
   
 #ifdef DEBUG_STATS
-  stats_checkext = stats_forceext =  stats_capext = stats_RazorTries = stats_Razors =  0;
+  sc->stats_checkext = sc->stats_forceext =  sc->stats_capext = sc->stats_RazorTries = sc->stats_Razors =  0;
+
+  stats_lazyEvalErrors = 0;
 
   int i; 
   
-  for (i = 0; i<MOVEGEN_TYPES; i++) { stats_MakeUnmake [i] = 0; }
-  for (i = 0; i<DEPTH_LIMIT; i++) { stats_NullTries [i] = stats_NullCuts [i] = 0; }
+  for (i = 0; i<MOVEGEN_TYPES; i++) { sc->stats_MakeUnmake [i] = 0; }
+  for (i = 0; i<DEPTH_LIMIT; i++) { sc->stats_NullTries [i] = sc->stats_NullCuts [i] = 0; }
 
 #endif
 
@@ -1960,7 +2098,7 @@ void findMove(move *rightMove)
   }	
 
   do {
-		gameBoard.copy(&AIBoard);
+		gameBoard.copy(&sc->AIBoard);
    		overideMove.makeBad();
 	
 
@@ -1971,23 +2109,23 @@ void findMove(move *rightMove)
 	
 	{
 
-	AIBoard.addPieceToHand(WHITE, ROOK, 1);
-	AIBoard.addPieceToHand(BLACK, ROOK, 1);
+	sc->AIBoard.addPieceToHand(WHITE, ROOK, 1);
+	sc->AIBoard.addPieceToHand(BLACK, ROOK, 1);
 
-    AIBoard.addPieceToHand(WHITE, KNIGHT, 1);
-	AIBoard.addPieceToHand(BLACK, KNIGHT, 1);
+    sc->AIBoard.addPieceToHand(WHITE, KNIGHT, 1);
+	sc->AIBoard.addPieceToHand(BLACK, KNIGHT, 1);
 	
-	AIBoard.addPieceToHand(WHITE, PAWN, 1);
-	AIBoard.addPieceToHand(BLACK, PAWN, 1);
+	sc->AIBoard.addPieceToHand(WHITE, PAWN, 1);
+	sc->AIBoard.addPieceToHand(BLACK, PAWN, 1);
 	
 	}
 	
-	stopThinking = reSearch = forceMove = 0;
+	sc->stopThinking = reSearch = forceMove = 0;
     parttoldgo = 0; // he tells us to go always for 1 move only
 	
 
 
-    searchRoot(MAX_SEARCH_DEPTH, rightMove, &bestValue);
+    searchRoot(sc, MAX_SEARCH_DEPTH, rightMove, &bestValue);
 	
 	/* Only for Bughouse */
 	if (currentRules == BUGHOUSE) 
@@ -2096,7 +2234,7 @@ void findMove(move *rightMove)
 
 void stopThought()
 {
- if(!sitting || pondering ) stopThinking = 1;
+ if(!sitting || pondering ) mainSearch.stopThinking = 1;
 }
 
 /* Function: startSearchOver
@@ -2109,12 +2247,14 @@ void stopThought()
 
 void startSearchOver()
 {
-  stopThinking = 1;
+  mainSearch.stopThinking = 1;
   reSearch = 1;
 
   /* Somethings changed the position by a lot,
-     the old hash values are no good */
+     the old hash values are no good.  The helpers would keep storing
+     values of the old kind into the cleared table, so they go first */
 
+  stopHelperThreads();
   zapHashValues();
  
 
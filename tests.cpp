@@ -17,6 +17,9 @@
  *  where <* move> is optional, else the whole game is looked at             *
  *  format is for example "34 WHITE" or "7 BLACK"                            *
  *                                                                           *
+ *  "sunsetter hashtest <threads*> <seconds*>" lets many threads store and   *
+ *  look up positions in the shared transposition table at the same time.    *
+ *                                                                           *
  *                                                                           *
  *************************************************************************** */
 
@@ -25,11 +28,19 @@
 #include <stdio.h>
 // #include <ctype.h> // from version 7g
 
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#include <atomic>
+#endif
+
 #include "board.h"
 #include "brain.h"
 #include "notation.h"
 #include "interface.h"
 
+
+extern thread_local int stats_hashCollisions;	/* from transposition.cpp */
+
 /* Function: nextToken
  * Input:    A file and a string to fill
  * Output:   None
@@ -236,6 +247,8 @@ for(;;)    // go through the whole game
     return(0);        
  }
 
+#define EVALS_PER_POSITION 100	/* in the eval() speed test */
+
 /* Function: speedtest
  * Input:    the arguments Sunsetter was called with 
  * Output:   0, -1 if an error occured
@@ -246,7 +259,7 @@ int speedtest(int argc, char **argv)
 {
  char buf[MAX_STRING], buf2[MAX_STRING]; 
  move gameMoves[MAX_GAME_LENGTH];
- int a, n;
+ int a, n, e;
  int makeUnmakeSpeed; 
  
  FILE *fin; 
@@ -352,6 +365,10 @@ output (buf);
 
 output ("\n\n starting eval() speed test ... \n"); 
 
+// computeEval(), the eval cache would find every position of the game 
+// again and the test would only time the cache.  Several times per 
+// position, so that the make/unmake time taken off isn't most of it
+
 
 startClockTime = getSysMilliSecs();
 
@@ -363,23 +380,23 @@ for (a = 0; a < 10000; a++)
 
 	{
 		 gameBoard.unchangeBoard(); 
-		 gameBoard.eval(); 
+		 for (e = 0; e < EVALS_PER_POSITION; e++) gameBoard.computeEval(); 
 	}	
 
 	for (n = 1; n <= movesInGame; n++) 
 
 	{
 		gameBoard.changeBoard(gameMoves[n]); 				
-		gameBoard.eval(); 
+		for (e = 0; e < EVALS_PER_POSITION; e++) gameBoard.computeEval(); 
 	}
 
 }
 
 endClockTime = getSysMilliSecs();
 
-sprintf (buf, "%d eval() at ", movesInGame * 10000 *2);
+sprintf (buf, "%lld eval() at ", (long long) movesInGame * 10000 *2 * EVALS_PER_POSITION);
 output (buf); 
-sprintf (buf, "%d eval per second. \n", (    ((movesInGame * 10000 *2) / (((int) (endClockTime - startClockTime))- makeUnmakeSpeed)) * 1000 ) ); 
+sprintf (buf, "%lld eval per second. \n", (    (((long long) movesInGame * 10000 *2 * EVALS_PER_POSITION) / (((int) (endClockTime - startClockTime))- makeUnmakeSpeed)) * 1000 ) ); 
 output (buf); 
 
 output ("\n\n starting MoveGen speed test ... \n"); 
@@ -396,8 +413,8 @@ for (a = 0; a < 10000; a++)
 
 	{
 		 gameBoard.unchangeBoard(); 
-		 AIBoard.aiMoves(moves);
-		 // not something like this: 		for (a = 0; a < 100000 ; a++) AIBoard.aiMoves(moves);
+		 gameBoard.aiMoves(moves);
+		 // not something like this: 		for (a = 0; a < 100000 ; a++) gameBoard.aiMoves(moves);
 		 // because a  compiler might optimize this in a way it is not a realistic test anymore
 	}	
 
@@ -405,7 +422,7 @@ for (a = 0; a < 10000; a++)
 
 	{
 		gameBoard.changeBoard(gameMoves[n]); 				
-		AIBoard.aiMoves(moves);
+		gameBoard.aiMoves(moves);
 	}
 
 }
@@ -423,3 +440,260 @@ fclose(fin);
 
 return(0);        
  }
+
+
+
+/* Results of the hash stress test, one per thread */
+
+long hashtestProbes[MAX_THREADS];
+long hashtestHits[MAX_THREADS];
+long hashtestCollisions[MAX_THREADS];
+
+
+/* The full keys of the positions a thread stored and of those it hit,
+   with the time of the store or the hit.  The time is taken from a 
+   counter shared by all threads, before a store and after a lookup, 
+   so a hit can only have seen stores with an earlier time. */
+
+struct hashtestKey {
+	qword key;
+	long time;
+};
+
+struct hashtestKeys {
+	hashtestKey *keys;
+	long count, size;
+};
+
+hashtestKeys hashtestStored[MAX_THREADS];
+hashtestKeys hashtestHitKeys[MAX_THREADS];
+
+#ifndef __EMSCRIPTEN__
+std::atomic<long> hashtestClock;
+#endif
+
+
+/* Function: addHashtestKey
+ * Input:    A list of keys, a key and its time.
+ * Output:   0 if there was no memory to add it, else 1.
+ * Purpose:  Appends the key, making the list bigger as needed.
+ */
+
+static int addHashtestKey(hashtestKeys *list, qword key, long time)
+{
+	hashtestKey *keys;
+
+	if (list->count == list->size)
+	{
+		keys = (hashtestKey *) realloc(list->keys, (list->size * 2 + 4096) * sizeof(hashtestKey));
+		if (keys == NULL) return 0;
+
+		list->keys = keys;
+		list->size = list->size * 2 + 4096;
+	}
+
+	list->keys[list->count].key = key;
+	list->keys[list->count].time = time;
+	list->count++;
+
+	return 1;
+}
+
+
+/* Function: compareKeys
+ * Input:    Two hashtestKeys, as qsort() and bsearch() hand them over.
+ * Output:   <0, 0 or >0 like strcmp().
+ * Purpose:  Sorts the stored keys, and for each key the earliest store 
+ *           first.  bsearch() is handed a time of -1, so it finds only
+ *           the key, there are no stores that early.
+ */
+
+static int compareKeys(const void *a, const void *b)
+{
+	const hashtestKey *x = (const hashtestKey *) a, *y = (const hashtestKey *) b;
+
+	if (x->key != y->key) return (x->key < y->key) ? -1 : 1;
+	if ((x->time < 0) || (y->time < 0)) return 0;
+
+	return (x->time < y->time) ? -1 : (x->time > y->time);
+}
+
+
+/* Function: hashtestThread
+ * Input:    The number of the thread and when to stop.
+ * Output:   None.
+ * Purpose:  Walks randomly through the game tree from the position in
+ *           gameBoard, and at every node looks the position up and then
+ *           stores it with a random depth, value and move.  All threads
+ *           start from the same position, so they keep hitting the same
+ *           slots of the table.  The full keys of all positions stored 
+ *           and hit are kept, so that hashtest() can find the hits of
+ *           positions nobody had stored yet, which lookup() should have 
+ *           missed.
+ */
+
+void hashtestThread(int id, long stopTime)
+{
+	boardStruct *board = new boardStruct;
+	move moves[MAX_MOVES];
+	transpositionEntry te;
+	int count, n, ply, walkLength, memoryLeft = 1;
+	unsigned int seed = 12345 + id * 7919;
+
+	gameBoard.copy(board);
+	stats_hashCollisions = 0;
+
+	while (memoryLeft && (getSysMilliSecs() < stopTime))
+	{
+		seed = seed * 1103515245 + 12345;
+		walkLength = 1 + (seed >> 16) % 12;
+
+		for (ply = 0; ply < walkLength; ply++)
+		{
+			hashtestProbes[id]++;
+
+			if (board->lookup(&te) != NULL)
+			{
+				hashtestHits[id]++;
+				memoryLeft &= addHashtestKey(&hashtestHitKeys[id], board->tableKey(), hashtestClock++);
+			}
+
+			count = board->moves(moves);
+			if (!count) break;
+
+			seed = seed * 1103515245 + 12345;
+			n = (seed >> 16) % count;
+
+			memoryLeft &= addHashtestKey(&hashtestStored[id], board->tableKey(), hashtestClock++);
+			board->store((seed >> 8) % 60, moves[n], (int) ((seed >> 4) % 1000) - 500, -INFINITY, INFINITY, ply);
+
+			board->changeBoard(moves[n]);
+
+			if (board->isInCheck(board->getColorOffMove()))
+			{
+				board->unchangeBoard();
+				break;
+			}
+		}
+
+		while (ply-- > 0) board->unchangeBoard();
+	}
+
+	hashtestCollisions[id] = stats_hashCollisions;
+
+	delete board;
+}
+
+
+/* Function: hashtest
+ * Input:    the arguments Sunsetter was called with 
+ * Output:   0, 1 if an error occured
+ * Purpose:  Hammers the transposition table with store() and lookup() from
+ *           many threads at once and reports how many key collisions 
+ *           lookup() detected and how many hits were of positions that 
+ *           no thread had stored, which got through undetected (should 
+ *           be 0).
+ */
+
+int hashtest(int argc, char **argv)
+{
+#ifndef __EMSCRIPTEN__
+
+	char buf[MAX_STRING];
+	int threads = 8, seconds = 5, n;
+	long probes = 0, hits = 0, collisions = 0, badHits = 0, stored = 0, i, j;
+	long stopTime;
+	hashtestKey *allStored, *found, hit;
+	std::thread workers[MAX_THREADS];
+
+	if (argc > 4) {
+		output("Usage:\n");
+		output("sunsetter hashtest <threads*> <seconds*>  * = optional\n");
+		return (1);
+	}
+
+	if (argc > 2) threads = atoi(argv[2]);
+	if (argc > 3) seconds = atoi(argv[3]);
+
+	if (threads < 1) threads = 1;
+	if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+	sprintf(buf, "starting hash stress test with %d threads for %d seconds\n", threads, seconds);
+	output(buf);
+
+	memset(hashtestProbes, 0, sizeof(hashtestProbes));
+	memset(hashtestHits, 0, sizeof(hashtestHits));
+	memset(hashtestCollisions, 0, sizeof(hashtestCollisions));
+	memset(hashtestStored, 0, sizeof(hashtestStored));
+	memset(hashtestHitKeys, 0, sizeof(hashtestHitKeys));
+	hashtestClock = 0;
+
+	stopTime = getSysMilliSecs() + seconds * 1000;
+
+	for (n = 0; n < threads; n++) workers[n] = std::thread(hashtestThread, n, stopTime);
+	for (n = 0; n < threads; n++) workers[n].join();
+
+	for (n = 0; n < threads; n++)
+	{
+		probes += hashtestProbes[n];
+		hits += hashtestHits[n];
+		collisions += hashtestCollisions[n];
+		stored += hashtestStored[n].count;
+	}
+
+	// A hit is good if any thread stored that position before
+
+	allStored = (hashtestKey *) malloc((stored + 1) * sizeof(hashtestKey));
+	if (allStored == NULL)
+	{
+		output("Not enough memory to check the hits\n");
+		return (1);
+	}
+
+	for (n = 0, stored = 0; n < threads; n++)
+	{
+		if (hashtestStored[n].count)
+		{
+			memcpy(allStored + stored, hashtestStored[n].keys, hashtestStored[n].count * sizeof(hashtestKey));
+		}
+		stored += hashtestStored[n].count;
+		free(hashtestStored[n].keys);
+	}
+
+	qsort(allStored, stored, sizeof(hashtestKey), compareKeys);
+
+	// Keep only the earliest store of each key
+
+	for (i = 0, j = 0; i < stored; i++)
+	{
+		if (!j || (allStored[i].key != allStored[j - 1].key)) allStored[j++] = allStored[i];
+	}
+	stored = j;
+
+	for (n = 0; n < threads; n++)
+	{
+		for (i = 0; i < hashtestHitKeys[n].count; i++)
+		{
+			hit.key = hashtestHitKeys[n].keys[i].key;
+			hit.time = -1;
+			found = (hashtestKey *) bsearch(&hit, allStored, stored, sizeof(hashtestKey), compareKeys);
+
+			if (!found || (found->time > hashtestHitKeys[n].keys[i].time)) badHits++;
+		}
+		free(hashtestHitKeys[n].keys);
+	}
+
+	free(allStored);
+
+	sprintf(buf, "Probes     : %ld\nHits       : %ld\nCollisions : %ld (detected, treated as miss)\nBad hits   : %ld (key not stored before, not detected)\n",
+		probes, hits, collisions, badHits);
+	output(buf);
+
+	return (badHits ? 1 : 0);
+
+#else
+
+	return 0;
+
+#endif
+}
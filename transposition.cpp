@@ -17,12 +17,18 @@
  *            of the information we got before, like a good move to try      *
  *            first.                                                         *
  *                                                                           *
- *            The tables are orginized like this:  There are two arrays, one *
- *            for each color.  The arrays are indexed with rightmost bits of *
- *            the hash value for the position (The hash value is a 64 bit    *
- *            value that each position maps to).  The arrays have the        *
- *            leftmost 48 bits of the hash value and at least the 16         *
- *            rightmost bits of the hash value are in the index.             *
+ *            The table is orginized like this:  There is one array for     *
+ *            both colors, indexed with the leftmost bits of the key of the  *
+ *            position, which is its hash value (a 64 bit value that each    *
+ *            position maps to) xor-ed with a number for the side to move.   *
+ *            The index is scaled to the number of buckets, so the table     *
+ *            can have any size.  Every index is a bucket                    *
+ *            of HASH_BUCKET_SIZE slots in half a cache line.  Each slot     *
+ *            keeps the entry, with the move in 16 bits and the rightmost    *
+ *            bits of the key, packed into one 64 bit word, so that all      *
+ *            search threads can share the table without locks, and a 16    *
+ *            bit check with the next bits of the key (see hashBucket in     *
+ *            board.h).                                                      *
  *                                                                           *
  *            Hash values are obtained with the Zobrist algorithm.  For each *
  *            piece and square a random number is generated.  The hash value *
@@ -39,6 +45,22 @@
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#endif
+
+#if !defined(_win32_) && !defined(__EMSCRIPTEN__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _win32_
+#include <xmmintrin.h>	// for _mm_prefetch()
+#endif
+
 #include "interface.h"
 #include "definitions.h"
 #include "board.h"
@@ -48,29 +70,66 @@
 
 
 extern int stats_hashFillingUp;
-extern int stats_hashSize; 
+extern qword stats_hashSize; 
 
 qword ssrandom64(void); 
 
 // = { NULL,NULL } added by Angrim
-transpositionEntry *lookupTable[COLORS] = { NULL,NULL };
-transpositionEntry *learnTable[COLORS] = { NULL,NULL };
-
-duword lookupMask;
+hashBucket *lookupTable = NULL;
+void *lookupMemory = NULL;		/* What malloc() or mmap() gave us for the 
+								   aligned lookupTable */
+qword lookupMapped = 0;			/* How many bytes are mmap()ed, 0 if malloc()ed */
+
+qword lookupBuckets;			/* How many buckets lookupTable has */
+int lookupLoaded = 0;			/* lookupTable came from hashload, keep it */
+
+/* The learn file starts with this header, followed by (learnMask + 1)
+   pairs of learnEntry, one for each color.  Where there is mmap() the 
+   file is mapped shared, so the table is the file and there is nothing to
+   read or write.  After every game all values lose 1%, that is done when
+   an entry is next used: each entry remembers the epoch (number of games
+   learned from) its value belongs to. */
+
+#define LEARN_FILE_MAGIC "SSLEARN"
+#define LEARN_FILE_VERSION 1
+
+struct learnFileHeader {
+  char magic[8];
+  duword version;			/* LEARN_FILE_VERSION */
+  duword entrySize;			/* sizeof(learnEntry) of the writer */
+  qword entries;			/* per color, a power of 2 */
+  duword epoch;				/* How many games were learned from */
+  char unused[CACHE_LINE - 28];
+};
+
+struct learnEntry {
+  qword hash : 48;			/* The upper 48 bits of the hash value */
+  sword value;				/* What we won or lost from here */
+  duword epoch;				/* The epoch value belongs to */
+};
+
+learnFileHeader *learnHeader = NULL;
+learnEntry (*learnTable)[COLORS] = NULL;
+qword learnMapped = 0;			/* How many bytes are mmap()ed, 0 if malloc()ed */
+qword learnSize = LEARN_SIZE;	/* How big a new learn file is made */
 duword learnMask; 
 
+thread_local int stats_hashCollisions;	/* Key bits matched, but the move didn't fit */
+
 /* hashNumbers is an array of random numbers for generating a hash value. */
 
 qword hashNumbers[COLORS][PIECES][64];
 qword hashHandNumbers[COLORS][PIECES][17];
 qword hashCastleNumbers[COLORS][2];
 qword hashEnPassantNumbers[66];  /* 66 to include room for OFF_BOARD */
+qword hashSideNumbers[COLORS];	 /* Only used for the transposition table key */
 
 #ifdef DEBUG_HASH
 qword hashNumbersT[COLORS][PIECES][64];
 qword hashHandNumbersT[COLORS][PIECES][17];
 qword hashCastleNumbersT[COLORS][2];
 qword hashEnPassantNumbersT[66];  /* 66 to include room for OFF_BOARD */
+qword hashSideNumbersT[COLORS];
 #endif
 
 /* Function: ssrandom64
@@ -91,33 +150,440 @@ qword ssrandom64(void) {
 
 
 
+/* Where the fields of an entry are in its 64 bit word */
+
+#define ENTRY_MOVENR_SHIFT 2
+#define ENTRY_DEPTH_SHIFT 5
+#define ENTRY_VALUE_SHIFT 13
+#define ENTRY_MOVE_SHIFT 29
+#define ENTRY_KEY_SHIFT 45
+#define ENTRY_KEY_MASK qword(0x7FFFF)
+#define ENTRY_CHECK_SHIFT 19	/* The check has the key bits after those */
+
+
+/* Function: packEntry
+ * Input:    The key of the position and the fields of a transposition
+ *           table entry.
+ * Output:   The fields packed into one 64 bit word.
+ * Purpose:  Bits 0-1 are the type, 2-4 the moveNr, 5-12 the depth, 13-28
+ *           the value, 29-44 the compact hash move and 45-63 the rightmost
+ *           19 bits of the key.  The leftmost bits of the key are already
+ *           given by the bucket the entry is in.
+ */
+
+static __forceinline qword packEntry(qword key, int type, int moveNr, int depth, int value, move m)
+{
+	return (qword) (type & 3) 
+		| ((qword) (moveNr & 7) << ENTRY_MOVENR_SHIFT)
+		| ((qword) (depth & 0xFF) << ENTRY_DEPTH_SHIFT) 
+		| ((qword) (word) value << ENTRY_VALUE_SHIFT)
+		| ((qword) m.compact() << ENTRY_MOVE_SHIFT)
+		| ((key & ENTRY_KEY_MASK) << ENTRY_KEY_SHIFT);
+}
+
+
+/* Function: unpackEntry
+ * Input:    A packed entry and where to put it.
+ * Output:   The compact hash move, which only the board can expand.
+ * Purpose:  The reverse of packEntry().
+ */
+
+static __forceinline word unpackEntry(qword data, transpositionEntry *te)
+{
+	te->type = byte (data & 3);
+	te->moveNr = byte ((data >> ENTRY_MOVENR_SHIFT) & 7);
+	te->depth = byte ((data >> ENTRY_DEPTH_SHIFT) & 0xFF);
+	te->value = sword (word ((data >> ENTRY_VALUE_SHIFT) & 0xFFFF));
+
+	return word ((data >> ENTRY_MOVE_SHIFT) & 0xFFFF);
+}
+
+
+/* Function: entryMatches
+ * Input:    A packed entry and a key.
+ * Output:   True if the entry may be of the position with the key.
+ * Purpose:  Empty slots are WORTHLESS (or 0, when they come fresh from 
+ *           mmap()) and never match.
+ */
+
+static __forceinline int entryMatches(qword data, qword key)
+{
+	return (((data >> ENTRY_KEY_SHIFT) & ENTRY_KEY_MASK) == (key & ENTRY_KEY_MASK))
+		&& ((data & 3) != WORTHLESS) && data;
+}
+
+
+/* Function: entryCheck
+ * Input:    A key and the packed entry stored with it.
+ * Output:   The check word of the entry.
+ * Purpose:  Bits 19-34 of the key, which with the 19 bits in the entry
+ *           make 35 bits to tell positions of a bucket apart.  It is 
+ *           xor-ed with the entry, so when two threads write a slot at
+ *           once and the entry of one ends up with the check of the
+ *           other, the slot most likely matches nothing.
+ */
+
+static __forceinline word entryCheck(qword key, qword data)
+{
+	return word ((key >> ENTRY_CHECK_SHIFT) ^ data);
+}
+
+
+
+/* hashsave writes this header, followed by the buckets as they are in
+   memory.  It is one cache line long, so the buckets in a mapped file
+   are aligned like allocated ones. */
+
+#define HASH_FILE_MAGIC "SSHASH"
+#define HASH_FILE_VERSION 1
+
+struct hashFileHeader {
+  char magic[8];
+  duword version;			/* HASH_FILE_VERSION */
+  duword bucketSize;		/* sizeof(hashBucket) of the writer */
+  qword buckets;
+  qword zobristCheck;		/* hashSideNumbers[BLACK], other random numbers
+							make the file useless */
+  sdword moveCircle;		/* hashMoveCircle when it was saved */
+  char unused[CACHE_LINE - 36];
+};
+
+
+/* Function: bucketIndex
+ * Input:    A transposition table key.
+ * Output:   The bucket it goes in.
+ * Purpose:  Scales the leftmost 31 bits of the key to the number of
+ *           buckets.  A multiplication instead of a mask, so that the
+ *           number of buckets need not be a power of 2.  Doesn't overflow
+ *           as long as there are less than MAX_HASH_BUCKETS.
+ */
+
+static __forceinline qword bucketIndex(qword key)
+{
+	return ((qword) ((duword) (key >> 33) & 0x7FFFFFFF) * lookupBuckets) >> 31;
+}
+
+
+/* Function: tableKey
+ * Input:    None.
+ * Output:   The key of the position in the transposition table.
+ * Purpose:  hashValue doesn't include the side to move, the learn table 
+ *           and the repetition check don't need it.  The transposition
+ *           table holds both colors, so the side to move is added here.
+ */
+
+qword boardStruct::tableKey()
+{
+	return hashValue ^ hashSideNumbers[onMove];
+}
+
+
+/* Function: slotWorth
+ * Input:    A packed entry.
+ * Output:   How much we'd lose if the slot was overwritten.
+ * Purpose:  Deeper searched slots are worth more, slots not used for a
+ *           couple of moves less.
+ */
+
+static __forceinline int slotWorth(qword data)
+{
+	int age = (hashMoveCircle - (int) ((data >> ENTRY_MOVENR_SHIFT) & 7)) & 7;
+
+	return (int) ((data >> ENTRY_DEPTH_SHIFT) & 0xFF) - HASH_AGE_WEIGHT * age;
+}
+
+
+/* Function: allocateBuckets
+ * Input:    How many buckets.
+ * Output:   The buckets, aligned to a cache line, or NULL.
+ * Purpose:  Gets the memory for the transposition table.  Where there is
+ *           mmap() we first ask for reserved huge pages, then for normal
+ *           pages that the kernel may back with transparent huge pages.
+ *           Either way the memory comes zeroed.  Otherwise malloc() is used,
+ *           which only promises 8 or 16 byte alignment, so we align by hand
+ *           and the caller has to clear the table.  *howAllocated is set to 
+ *           a description for the user.
+ */
+
+static hashBucket *allocateBuckets(qword buckets, const char **howAllocated)
+{
+	qword bytes = buckets * sizeof(hashBucket);
+
+	lookupMapped = 0;
+
+#if !defined(_win32_) && !defined(__EMSCRIPTEN__)
+
+	void *memory;
+	qword mapSize = (bytes + HUGE_PAGE - 1) & ~((qword) HUGE_PAGE - 1);
+
+#ifdef MAP_HUGETLB
+	memory = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, 
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+	if (memory != MAP_FAILED)
+	{
+		lookupMemory = memory;
+		lookupMapped = mapSize;
+		*howAllocated = "huge pages";
+		return (hashBucket *) memory;
+	}
+#endif
+
+	// one huge page more, so the table can start on a huge page boundary
+
+	memory = mmap(NULL, mapSize + HUGE_PAGE, PROT_READ | PROT_WRITE, 
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (memory != MAP_FAILED)
+	{
+		lookupMemory = memory;
+		lookupMapped = mapSize + HUGE_PAGE;
+		memory = (void *) (((size_t) memory + HUGE_PAGE - 1) & ~((size_t) HUGE_PAGE - 1));
+
+#ifdef MADV_HUGEPAGE
+		madvise(memory, mapSize, MADV_HUGEPAGE);
+		*howAllocated = "transparent huge pages";
+#else
+		*howAllocated = "mmap";
+#endif
+		return (hashBucket *) memory;
+	}
+
+#endif
+
+	lookupMemory = malloc((size_t) bytes + CACHE_LINE - 1);
+	*howAllocated = "malloc";
+
+	if (lookupMemory == NULL) return NULL;
+
+	return (hashBucket *) (((size_t) lookupMemory + CACHE_LINE - 1) & ~((size_t) CACHE_LINE - 1));
+}
+
+
+/* Function: freeBuckets
+ * Input:    None.
+ * Output:   None.
+ * Purpose:  Gives back the memory of the transposition table.
+ */
+
+static void freeBuckets()
+{
+#if !defined(_win32_) && !defined(__EMSCRIPTEN__)
+	if (lookupMapped) munmap(lookupMemory, lookupMapped);
+	else 
+#endif
+	free(lookupMemory);
+
+	lookupMemory = NULL;
+	lookupTable = NULL;
+	lookupMapped = 0;
+}
+
+
+/* Function: clearBucketRange
+ * Input:    The first and one after the last bucket to clear, and what
+ *           to fill the slots with.
+ * Output:   None.
+ * Purpose:  Does the work for clearBuckets().
+ */
+
+static void clearBucketRange(qword first, qword last, qword data)
+{
+	qword n;
+	int i;
+
+	for (n = first; n < last; n++) 
+	{
+		for (i = 0; i < HASH_BUCKET_SIZE; i++) 
+		{
+			lookupTable[n].data[i] = data;
+			lookupTable[n].check[i] = 0;
+
+#ifdef DEBUG_HASH
+			lookupTable[n].hashT[i] = qword(0);
+#endif
+		}
+	}
+}
+
+
+/* Function: clearBuckets
+ * Input:    What to fill the slots with.
+ * Output:   None.
+ * Purpose:  Empties every slot of the transposition table, data should be
+ *           0 or of type WORTHLESS so that no position matches it.  A big 
+ *           table is cleared by CORES threads at once, each taking one chunk.
+ */
+
+static void clearBuckets(qword data)
+{
+	qword chunk, first;
+	int n, threads = 1;
+
+#ifndef __EMSCRIPTEN__
+
+	std::thread clearThreads[MAX_THREADS];
+
+	if (lookupBuckets * sizeof(hashBucket) >= MIN_PARALLEL_CLEAR)
+	{
+		threads = min(max(CORES, 1), MAX_THREADS);
+	}
+
+	chunk = lookupBuckets / threads;
+
+	for (n = 1, first = chunk; n < threads; n++, first += chunk)
+	{
+		clearThreads[n] = std::thread(clearBucketRange, first, 
+			(n == threads - 1) ? lookupBuckets : first + chunk, data);
+	}
+
+	clearBucketRange(0, (threads == 1) ? lookupBuckets : chunk, data);
+
+	for (n = 1; n < threads; n++) 
+	{
+		clearThreads[n].join();
+	}
+
+#else
+
+	clearBucketRange(0, lookupBuckets, data);
+
+#endif
+}
+
+
+
+/* Function: learnValue
+ * Input:    A learn table entry.
+ * Output:   Its value, aged for the games since it was last changed.
+ * Purpose:  Lazy version of taking 1% off all values after every game.
+ *           Below 100 that does nothing, so the loop is short.
+ */
+
+static int learnValue(learnEntry *entry)
+{
+	int value = entry->value;
+	duword age = learnHeader->epoch - entry->epoch;
+
+	while (age-- && (value / 100)) 
+	{
+		value -= value / 100;
+	}
+
+	return value;
+}
+
+
+/* Function: closeLearnTable
+ * Input:    None.
+ * Output:   None.
+ * Purpose:  Gives back the memory or mapping of the learn table.
+ */
+
+static void closeLearnTable()
+{
+	if (learnHeader == NULL) return;
+
+#if !defined(_win32_) && !defined(__EMSCRIPTEN__)
+	if (learnMapped) munmap(learnHeader, learnMapped);
+	else
+#endif
+	free(learnHeader);
+
+	learnHeader = NULL;
+	learnTable = NULL;
+	learnMapped = 0;
+	learnMask = 0;
+}
+
+
+/* Function: importOldLearnFile
+ * Input:    None.
+ * Output:   None.
+ * Purpose:  Learn files of earlier versions were the two per color arrays
+ *           of transpositionEntry, without a header.  With 65536 or more 
+ *           entries the index gives the 16 bits of the hash value the 
+ *           entry doesn't have, so the entries can be put where they 
+ *           belong in a table of any size.
+ */
+
+static void importOldLearnFile()
+{
+	FILE *oldFile; 
+	transpositionEntry old[COLORS];
+	qword n, entries, hashValue;
+	color c;
+	char buf[MAX_STRING];
+
+	sprintf (buf,"ss-%s.bin",VERSION); 
+	oldFile = fopen(buf, "rb");
+
+	if (!oldFile) return;
+
+	fseek(oldFile, 0, SEEK_END);
+	entries = (qword) ftell(oldFile) / sizeof(old);
+	fseek(oldFile, 0, SEEK_SET);
+
+	if ((entries < 0x10000) || (entries & (entries - 1)))
+	{
+		fclose(oldFile);
+		return;
+	}
+
+	for (n = 0; n < entries && fread(old, sizeof(old), 1, oldFile) == 1; n++)
+	{
+		for (c = WHITE; c <= BLACK; c = (color) (c + 1))
+		{
+			if (!old[c].value) continue;
+
+			hashValue = ((qword) old[c].hash << 16) | (n & 0xFFFF);
+
+			learnTable[hashValue & learnMask][c].hash = old[c].hash;
+			learnTable[hashValue & learnMask][c].value = old[c].value;
+			learnTable[hashValue & learnMask][c].epoch = learnHeader->epoch;
+		}
+	}
+
+	fclose(oldFile);
+
+	sprintf (buf,"Imported learn file ss-%s.bin.\n",VERSION); 
+	output(buf);
+}
+
+
 /* Function: saveLearnTableToDisk
  * Input:    None.
  * Output:   None.
  * Purpose:  Used to save the learn table to disk when Sunsetter quits. 
+ *           A mapped table is the file already, the kernel is only asked
+ *           to start writing it.
  */
 
 
 void saveLearnTableToDisk()
 
 {
-	
 	FILE *learnFile; 
-	unsigned int n;
 	char fileName[MAX_STRING];
 
+	if (learnHeader == NULL) return;
 
-	sprintf (fileName,"ss-%s.bin",VERSION); 
+#if !defined(_win32_) && !defined(__EMSCRIPTEN__)
+	if (learnMapped) 
+	{
+		msync(learnHeader, learnMapped, MS_ASYNC);
+		return;
+	}
+#endif
+
+	sprintf (fileName,"ss-%s.learn",VERSION); 
 
 	learnFile = fopen(fileName, "wb");
   
 	assert (learnFile);
 
-	for(n = 0; n <= learnMask; n++) 
-	{
-		fwrite(&learnTable[WHITE][n], sizeof(transpositionEntry), 1, learnFile);	
-		fwrite(&learnTable[BLACK][n], sizeof(transpositionEntry), 1, learnFile);	
-	}
+	fwrite(learnHeader, sizeof(learnFileHeader) + (size_t) learnHeader->entries * sizeof(learnEntry) * COLORS, 
+		1, learnFile);
 
 	fclose(learnFile);
 
@@ -128,62 +594,158 @@ void saveLearnTableToDisk()
  * Input:		None.
  * Output:		None.
  * Purpose:		Used to read the learn table from disk when 
- *				Sunsetter is started and gets the command "learn". 
+ *				Sunsetter is started and gets the command "learn".
+ *				If there is no learn file one of learnSize bytes is
+ *				made, else the file keeps the size it has. 
  */
 
 void readLearnTableFromDisk()
 
 {
-
-	FILE *learnFile; 
-	unsigned int n;
 	char buf[MAX_STRING]; 
+	qword entries, bytes, fileBytes = 0;
+	const char *created = "Loaded";
+	learnFileHeader *header;
 
 #ifdef DEBUG_LEARN
 
 	int highestValue = 0; 
 	int numberValue = 0; 
+	qword n;
 
 #endif
 
-	sprintf (buf,"ss-%s.bin",VERSION); 
-	learnFile = fopen(buf, "rb");
+	closeLearnTable();
 
-	memset(learnTable, 0, sizeof(learnTable));
- 
-	if(!learnFile) 
+	for (entries = 0x10000; entries * 2 * sizeof(learnEntry) * COLORS <= learnSize; entries *= 2);
+
+	sprintf (buf,"ss-%s.learn",VERSION); 
+
+#if !defined(_win32_) && !defined(__EMSCRIPTEN__)
+
+	struct stat fileStat;
+	void *memory;
+	int fd = open(buf, O_RDWR | O_CREAT, 0644);
+
+	if ((fd < 0) || (fstat(fd, &fileStat) != 0))
 	{
-		saveLearnTableToDisk(); 
-		output ("Created empty learn file.\n\n"); 
-		learnFile = fopen(buf, "rb");
+		if (fd >= 0) close(fd);
+		output("Could not open the learn file.\n");
+		return;
 	}
 
-	for(n = 0; n <= learnMask; n++) 
+	fileBytes = (qword) fileStat.st_size;
+
+	if (fileBytes >= sizeof(learnFileHeader)) 
 	{
-		fread(&learnTable[WHITE][n], sizeof(transpositionEntry), 1, learnFile);	
-		fread(&learnTable[BLACK][n], sizeof(transpositionEntry), 1, learnFile);	
+		bytes = fileBytes;
+	}
+	else 
+	{
+		bytes = sizeof(learnFileHeader) + entries * sizeof(learnEntry) * COLORS;
+		fileBytes = 0;
 
-#ifdef DEBUG_LEARN
+		if (ftruncate(fd, bytes) != 0)
+		{
+			close(fd);
+			output("Could not make the learn file.\n");
+			return;
+		}
+	}
+
+	memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED)
+	{
+		output("Could not map the learn file.\n");
+		return;
+	}
 
-		if (learnTable[WHITE][n].value) numberValue++; 
-		if (learnTable[BLACK][n].value) numberValue++; 
+	header = (learnFileHeader *) memory;
+	learnMapped = bytes;
 
-		if (abs(learnTable[WHITE][n].value) > abs(highestValue)) highestValue = learnTable[WHITE][n].value; 
-		if (abs(learnTable[BLACK][n].value) > abs(highestValue)) highestValue = learnTable[BLACK][n].value; 
+#else
+
+	FILE *learnFile = fopen(buf, "rb");
+
+	if (learnFile)
+	{
+		fseek(learnFile, 0, SEEK_END);
+		fileBytes = (qword) ftell(learnFile);
+		fseek(learnFile, 0, SEEK_SET);
+	}
+
+	bytes = (fileBytes >= sizeof(learnFileHeader)) ? fileBytes : 
+		sizeof(learnFileHeader) + entries * sizeof(learnEntry) * COLORS;
+
+	header = (learnFileHeader *) calloc(1, (size_t) bytes);
+
+	if (!header)
+	{
+		if (learnFile) fclose(learnFile);
+		output("Not enough memory for the learn table\n");
+		return;
+	}
+
+	if (fileBytes >= sizeof(learnFileHeader)) 
+	{
+		fread(header, (size_t) bytes, 1, learnFile);
+	}
+	else fileBytes = 0; 
+
+	if (learnFile) fclose(learnFile);
 
 #endif
 
+	learnHeader = header;
+
+	if (!fileBytes)
+	{
+		strcpy(header->magic, LEARN_FILE_MAGIC);
+		header->version = LEARN_FILE_VERSION;
+		header->entrySize = sizeof(learnEntry);
+		header->entries = entries;
+		header->epoch = 0;
+		created = "Created";
+	}
+	else if (strncmp(header->magic, LEARN_FILE_MAGIC, sizeof(header->magic)) 
+		|| (header->version != LEARN_FILE_VERSION)
+		|| (header->entrySize != sizeof(learnEntry))
+		|| (header->entries < 0x10000) || (header->entries & (header->entries - 1))
+		|| (bytes != sizeof(learnFileHeader) + header->entries * sizeof(learnEntry) * COLORS))
+	{
+		sprintf(buf, "ss-%s.learn is not a learn file of this version of Sunsetter.\n", VERSION);
+		output(buf);
+		closeLearnTable();
+		return;
 	}
 
+	learnTable = (learnEntry (*)[COLORS]) (header + 1);
+	learnMask = (duword) (header->entries - 1);
+
+	if (!fileBytes) importOldLearnFile();
+
+	sprintf(buf, "%s %lld byte learn table, learned from %u games.\n\n", created, 
+		(long long) (header->entries * sizeof(learnEntry) * COLORS), header->epoch);
+	output(buf);
+
 #ifdef DEBUG_LEARN
 
+	for(n = 0; n <= learnMask; n++) 
+	{
+		if (learnTable[n][WHITE].value) numberValue++; 
+		if (learnTable[n][BLACK].value) numberValue++; 
+
+		if (abs(learnValue(&learnTable[n][WHITE])) > abs(highestValue)) highestValue = learnValue(&learnTable[n][WHITE]); 
+		if (abs(learnValue(&learnTable[n][BLACK])) > abs(highestValue)) highestValue = learnValue(&learnTable[n][BLACK]); 
+	}
+
 	sprintf (buf,"Learn: Learned positions: %d \n",numberValue); output (buf); 
 	sprintf (buf,"Learn: Highest value    : %d \n\n",highestValue); output (buf); 
 
 #endif
 
-	fclose(learnFile);
-
 }
 
 
@@ -191,102 +753,237 @@ void readLearnTableFromDisk()
 /* Function: makeTranspositionTable
  * Input:    the size for the table.
  * Output:   0 if successfull, -1 if not.
- * Purpose:  Used to create the transposition table and learn table
+ * Purpose:  Used to create the transposition table.
  */
 
-int makeTranspositionTable(unsigned int size)
+int makeTranspositionTable(qword size)
 {
-  unsigned int learnSize = LEARN_SIZE; 
-  unsigned int logOfSize, n;
+  const char *howAllocated;
   char buf[MAX_STRING];
 
-  if(lookupTable[WHITE] != NULL) free(lookupTable[WHITE]);
-  if(lookupTable[BLACK] != NULL) free(lookupTable[BLACK]);
-
-  if(learnTable[WHITE] != NULL) free(learnTable[WHITE]);
-  if(learnTable[BLACK] != NULL) free(learnTable[BLACK]);
-
-  /* Am I reading the wrong standard C library specification or is microsoft?
-     Acording to mine I shouldn't have to do that. */
+  /* Check before anything is freed, the caller will most likely try
+     again with MIN_HASH_SIZE */
 
   if(size < MIN_HASH_SIZE) {
     sprintf(buf, "The transposition table size must be > %d bytes\n",
 	    (int)MIN_HASH_SIZE);
     output(buf);
-    lookupTable[WHITE] = lookupTable[BLACK] = NULL;
     return -1;
   }
 
-  size /= sizeof(transpositionEntry) * 2;
+  stopHelperThreads();  // they might be using the old table
 
-  logOfSize = 1;
-  for(n = 2; n < size; n *= 2) logOfSize++;
-  if(n != size) logOfSize--;
-  lookupMask = (1 << logOfSize) - 1;
-  size = 1 << logOfSize;
+  if(lookupMemory != NULL) freeBuckets();
+  lookupLoaded = 0;
 
-  learnSize /= sizeof(transpositionEntry) * 2;
+  /* All of the memory is used, the number of buckets doesn't have to be a 
+     power of 2 */
 
-  logOfSize = 1;
-  for(n = 2; n < learnSize; n *= 2) logOfSize++;
-  if(n != learnSize) logOfSize--;
-  learnMask = (1 << logOfSize) - 1;
-  learnSize = 1 << logOfSize;
+  size /= sizeof(hashBucket);
+  if (size > MAX_HASH_BUCKETS) size = MAX_HASH_BUCKETS;
+  lookupBuckets = size;
 
+  lookupTable = allocateBuckets(size, &howAllocated);
+  
+  if(!lookupTable) 
+  {
+    output("Not enough memory to make the transposition table\n");
+    freeBuckets();
+    lookupBuckets = 0;
+    return -1;
+  }
+  // mmap()ed memory is zero already
 
-  learnTable[WHITE] = 
-    (transpositionEntry *) malloc(learnSize * sizeof(transpositionEntry));
-  learnTable[BLACK] = 
-    (transpositionEntry *) malloc(learnSize * sizeof(transpositionEntry));
-    
-  lookupTable[WHITE] = 
-    (transpositionEntry *) malloc(size * sizeof(transpositionEntry));
-  lookupTable[BLACK] = 
-    (transpositionEntry *) malloc(size * sizeof(transpositionEntry));
+  if (!lookupMapped) clearBuckets(qword(0));
+
+  sprintf(buf, "Created %lld byte transposition table (%s).\n\n", 
+	  (long long)(size * sizeof(hashBucket)), howAllocated);
   
-  if(!lookupTable[WHITE] || !lookupTable[BLACK] ||
-	 !learnTable[WHITE] || !learnTable[BLACK]) 
+  output(buf);
+  stats_hashSize = size * HASH_BUCKET_SIZE; 
+  return 0;
+}
+
+
+
+/* Function: saveTranspositionTable
+ * Input:    The file name.
+ * Output:   0 if successfull, -1 if not.
+ * Purpose:  Writes the transposition table to a file in one go, so that 
+ *           loadTranspositionTable() can bring it back after a restart.
+ */
+
+int saveTranspositionTable(const char *fileName)
+{
+  FILE *hashFile;
+  hashFileHeader header;
+  char buf[MAX_STRING];
+  size_t written;
+
+  if (lookupTable == NULL) return -1;
+
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, HASH_FILE_MAGIC);
+  header.version = HASH_FILE_VERSION;
+  header.bucketSize = sizeof(hashBucket);
+  header.buckets = lookupBuckets;
+  header.zobristCheck = hashSideNumbers[BLACK];
+  header.moveCircle = hashMoveCircle;
+
+  hashFile = fopen(fileName, "wb");
+
+  if (!hashFile)
+  {
+    sprintf(buf, "Could not open %s for writing.\n", fileName);
+    output(buf);
+    return -1;
+  }
+
+  written = fwrite(&header, sizeof(header), 1, hashFile);
+  if (written == 1) written = fwrite(lookupTable, sizeof(hashBucket), (size_t) lookupBuckets, hashFile);
+
+  if ((fclose(hashFile) != 0) || (written != (size_t) lookupBuckets))
   {
-    output("Not enough memory to make the transposition tables\n");
-    free(lookupTable[WHITE]);
-    free(lookupTable[BLACK]);
-    lookupTable[WHITE] = lookupTable[BLACK] = NULL;
-	free(learnTable[WHITE]);
-    free(learnTable[BLACK]);
-    learnTable[WHITE] = learnTable[BLACK] = NULL;
-    lookupMask = 0;
-	learnMask = 0; 
+    sprintf(buf, "Error writing %s.\n", fileName);
+    output(buf);
     return -1;
   }
-  // Angrim in 7g suggests instead of the below to use calloc (not malloc) above.
 
-  for(n = 0; n < size; n++) 
+  sprintf(buf, "Saved %lld byte transposition table to %s.\n", 
+	  (long long)(lookupBuckets * sizeof(hashBucket)), fileName);
+  output(buf);
+
+  return 0;
+}
+
+
+/* Function: loadTranspositionTable
+ * Input:    The file name.
+ * Output:   0 if successfull, -1 if not.
+ * Purpose:  Makes a table written by saveTranspositionTable() the 
+ *           transposition table, with the size it had then.  Where there is
+ *           mmap() the file is mapped privately, so loading doesn't take 
+ *           longer for a bigger table, the pages are read when first used 
+ *           and the file isn't changed by the search.  Otherwise it is read
+ *           into a new table.  newGameHashValues() leaves a loaded table 
+ *           alone, so it survives "variant", "setboard" and "analyze" until
+ *           the next "hash" or "memory" command, or until the piece values 
+ *           or the rules change.
+ */
+
+int loadTranspositionTable(const char *fileName)
+{
+  hashFileHeader header;
+  hashBucket *table;
+  const char *howLoaded;
+  char buf[MAX_STRING];
+  qword bytes;
+
+#if !defined(_win32_) && !defined(__EMSCRIPTEN__)
+
+  struct stat fileStat;
+  void *memory;
+  int fd = open(fileName, O_RDONLY);
+
+  if ((fd < 0) || (fstat(fd, &fileStat) != 0) || 
+	  (read(fd, &header, sizeof(header)) != sizeof(header)))
   {
-    lookupTable[WHITE][n].hash =  qword(0);
-    lookupTable[BLACK][n].hash =  qword(0);
+    if (fd >= 0) close(fd);
+    sprintf(buf, "Could not read %s.\n", fileName);
+    output(buf);
+    return -1;
+  }
 
-#ifdef DEBUG_HASH
-	lookupTable[WHITE][n].hashT =  qword(0);
-    lookupTable[BLACK][n].hashT =  qword(0);
-#endif  
+  bytes = (qword) fileStat.st_size;
+
+#else
+
+  FILE *hashFile = fopen(fileName, "rb");
+
+  if (!hashFile || (fread(&header, sizeof(header), 1, hashFile) != 1))
+  {
+    if (hashFile) fclose(hashFile);
+    sprintf(buf, "Could not read %s.\n", fileName);
+    output(buf);
+    return -1;
   }
 
-  for(n = 0; n < learnSize; n++) 
+  bytes = sizeof(header) + header.buckets * sizeof(hashBucket);
+
+#endif
+
+  if (strncmp(header.magic, HASH_FILE_MAGIC, sizeof(header.magic)) 
+	  || (header.version != HASH_FILE_VERSION)
+	  || (header.bucketSize != sizeof(hashBucket))
+	  || (header.zobristCheck != hashSideNumbers[BLACK])
+	  || (header.buckets == 0) || (header.buckets > MAX_HASH_BUCKETS)
+	  || (bytes != sizeof(header) + header.buckets * sizeof(hashBucket))
+	  || (header.moveCircle < 0) || (header.moveCircle > 7))
+  {
+#if !defined(_win32_) && !defined(__EMSCRIPTEN__)
+    close(fd);
+#else
+    fclose(hashFile);
+#endif
+    sprintf(buf, "%s is not a hash file of this version of Sunsetter.\n", fileName);
+    output(buf);
+    return -1;
+  }
+
+  stopHelperThreads();  // they might be using the old table
+
+#if !defined(_win32_) && !defined(__EMSCRIPTEN__)
+
+  memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (memory == MAP_FAILED)
   {
-  	learnTable[WHITE][n].hash =  qword(0);
-    learnTable[BLACK][n].hash =  qword(0);
-	learnTable[WHITE][n].value =  0;
-    learnTable[BLACK][n].value =  0;
+    sprintf(buf, "Could not map %s.\n", fileName);
+    output(buf);
+    return -1;
+  }
+
+  if(lookupMemory != NULL) freeBuckets();
+
+  lookupMemory = memory;
+  lookupMapped = bytes;
+  table = (hashBucket *) ((char *) memory + sizeof(header));
+  howLoaded = "mapped";
+
+#else
+
+  if(lookupMemory != NULL) freeBuckets();
 
+  table = allocateBuckets(header.buckets, &howLoaded);
 
+  if (!table || (fread(table, sizeof(hashBucket), (size_t) header.buckets, hashFile) != header.buckets))
+  {
+    fclose(hashFile);
+    output("Could not load the transposition table\n");
+    freeBuckets();
+    lookupBuckets = 0;
+    return -1;
   }
-  
 
-  sprintf(buf, "Created %d byte transposition table and %d byte learn table.\n\n", 
-	  (int)(size * sizeof(transpositionEntry) * 2), (int)(learnSize * sizeof(transpositionEntry) * 2));
-  
+  fclose(hashFile);
+  howLoaded = "read";
+
+#endif
+
+  lookupTable = table;
+  lookupBuckets = header.buckets;
+  lookupLoaded = 1;
+  stats_hashSize = lookupBuckets * HASH_BUCKET_SIZE;
+
+  // the entries of the last move it was saved on are the newest ones now
+
+  hashMoveCircle = header.moveCircle;
+
+  sprintf(buf, "Loaded %lld byte transposition table from %s (%s).\n", 
+	  (long long)(lookupBuckets * sizeof(hashBucket)), fileName, howLoaded);
   output(buf);
-  stats_hashSize = size; 
+
   return 0;
 }
 
@@ -370,6 +1067,17 @@ void boardStruct::initHash()
     hashCastleNumbersT[BLACK][KING_SIDE] = ssrandom64();
     hashCastleNumbersT[BLACK][QUEEN_SIDE] = ssrandom64();
 #endif
+
+	/* Generated last, so the numbers above and with them the learn 
+	   table stay the same */
+
+	hashSideNumbers[WHITE] = qword(0);
+	hashSideNumbers[BLACK] = ssrandom64();
+
+#ifdef DEBUG_HASH
+	hashSideNumbersT[WHITE] = qword(0);
+	hashSideNumbersT[BLACK] = ssrandom64();
+#endif
  
 
 	srand(time(NULL));
@@ -378,6 +1086,7 @@ void boardStruct::initHash()
   /* Make a hash value for the position */
 
   hashValue = qword(0);
+  pawnHashValue = qword(0);
 
 #ifdef DEBUG_HASH
   hashValueT = qword(0); 
@@ -388,6 +1097,8 @@ void boardStruct::initHash()
     sq = firstSquare(bb.data);
     bb.unsetSquare(sq);
     hashValue += hashNumbers[WHITE][position[sq]][sq];
+    if (position[sq] == PAWN || position[sq] == KING)
+      pawnHashValue ^= hashNumbers[WHITE][position[sq]][sq];
 
 #ifdef DEBUG_HASH
 	hashValueT += hashNumbersT[WHITE][position[sq]][sq];
@@ -399,6 +1110,8 @@ void boardStruct::initHash()
     sq = firstSquare(bb.data);
     bb.unsetSquare(sq);
     hashValue += hashNumbers[BLACK][position[sq]][sq];
+    if (position[sq] == PAWN || position[sq] == KING)
+      pawnHashValue ^= hashNumbers[BLACK][position[sq]][sq];
 
 #ifdef DEBUG_HASH
 	hashValueT += hashNumbersT[BLACK][position[sq]][sq];
@@ -439,14 +1152,18 @@ void boardStruct::initHash()
 
 void zapHashValues()
 {
-  unsigned int n;
   int moveNrInit;
 
+  clearEvalCache();
+
+  // a loaded table was valued the old way too
+
+  lookupLoaded = 0;
+
   /* 
   // Angrims Code instead of the loop below.
   // 
-  memset(lookupTable[WHITE], 0, stats_hashSize * sizeof(transpositionEntry));
-  memset(lookupTable[BLACK], 0, stats_hashSize * sizeof(transpositionEntry));
+  memset(lookupTable, 0, lookupBuckets * sizeof(hashBucket));
   */ 
 
   moveNrInit = hashMoveCircle -1; 
@@ -455,19 +1172,29 @@ void zapHashValues()
 assert ((moveNrInit >= 0) && (moveNrInit <= 7));
 
 
-  for(n = 0; n <= lookupMask; n++) {
-    lookupTable[WHITE][n].hash = qword(0);
-    lookupTable[BLACK][n].hash = qword(0);
+  // the moveNr marks the empty slots as old
 
-    lookupTable[WHITE][n].moveNr = moveNrInit;
-    lookupTable[BLACK][n].moveNr = moveNrInit;
+  clearBuckets(((qword) moveNrInit << ENTRY_MOVENR_SHIFT) | WORTHLESS);
+}
 
-#ifdef DEBUG_HASH
-	lookupTable[WHITE][n].hashT = qword(0);
-    lookupTable[BLACK][n].hashT = qword(0);
-#endif
-	
+
+/* Function: newGameHashValues
+ * Input:    True if the values or the rules changed with the new game.
+ * Output:   None.
+ * Purpose:  Used for "variant", "reset" and "setboard".  A table from 
+ *           hashload is what the user wants searched from, so it is kept
+ *           as long as its values are still good, else zapHashValues().
+ */
+
+void newGameHashValues(int valuesChanged)
+{
+  if (lookupLoaded && !valuesChanged) 
+  {
+	  clearEvalCache();
+	  return;
   }
+
+  zapHashValues();
 }
 
 
@@ -477,13 +1204,16 @@ assert ((moveNrInit >= 0) && (moveNrInit <= 7));
  * Purpose:  Used to update a position's hash value.  This function is called
  *           when a piece is added to or substracted from  a square.  It XORS
  *           the board's hashValue with the hash number corresponding
- *           to the piece and square.
+ *           to the piece and square.  Pawns and kings go into 
+ *           pawnHashValue as well.
  */
 
 void boardStruct::addToHash(color c, piece p, square sq)
 {
   hashValue ^= hashNumbers[c][p][sq];
 
+  if (p == PAWN || p == KING) pawnHashValue ^= hashNumbers[c][p][sq];
+
 #ifdef DEBUG_HASH
   hashValueT ^= hashNumbersT[c][p][sq];
 #endif
@@ -580,7 +1310,10 @@ void boardStruct::addEnPassantHash(square sq)
 void boardStruct::store(int depthSearched, move bestMove,
 			int value, int alpha, int beta, int ply)
 { 
-  duword offset;
+  hashBucket *bucket;
+  transpositionEntry old;
+  int type, i, slot, worth, lowestWorth, samePosition = 0; 
+  qword key, data;
 
 
 assert (depthSearched <= 128);
@@ -599,47 +1332,67 @@ assert (hashMoveCircle >= 0);
 assert  (hashMoveCircle <= 7);
 
 
-  offset = (duword) (hashValue & lookupMask);  
+  key = tableKey();
+  bucket = &lookupTable[bucketIndex(key)];
+
+  // If the position is in the bucket already we use its slot, else the one
+  // that is worth the least: searched shallow and not used for long.
+  // Only the replacement decision depends on the old entries, if another
+  // thread is writing them right now that decision is a bit off, no harm done
+
+  slot = 0;
+  lowestWorth = INFINITY;
 
+  for (i = 0; i < HASH_BUCKET_SIZE; i++)
+  {
+	  data = bucket->data[i];
+
+	  if (entryMatches(data, key) && (bucket->check[i] == entryCheck(key, data)))
+	  {
+		  slot = i;
+		  samePosition = 1;
+		  break;
+	  }
+
+	  worth = slotWorth(data);
+	  if (worth < lowestWorth)
+	  {
+		  lowestWorth = worth;
+		  slot = i;
+	  }
+  }
+
+  unpackEntry(bucket->data[slot], &old);
   
-  if (hashMoveCircle != lookupTable[onMove][offset].moveNr) 
+  if (hashMoveCircle != old.moveNr) 
 
   {
 	  stats_hashFillingUp++; 
   }
 	  
-  // we overwrite the hash from a different or same position with the same
-  // key if 
-  // a) it was an old position or 
+  // we overwrite a different position always, the same position if 
+  // a) it was stored during an earlier move or 
   // b) it was now searched deeper or
-  // c) we got an exact score, and the position we overwrite doesnt
-
-  // c) is a bit dubious, but only 1% are exact scores, and with a big 
-  // hash tablewe should be ok
+  // c) we got an exact score, and the entry we overwrite doesnt
   
-  if ((hashMoveCircle != lookupTable[onMove][offset].moveNr) 
-	  || (depthSearched > lookupTable[onMove][offset].depth) 
-	  || ((lookupTable[onMove][offset].type != EXACT) 
+  if (!samePosition
+	  || (hashMoveCircle != old.moveNr) 
+	  || (depthSearched > old.depth) 
+	  || ((old.type != EXACT) 
 	  && (((value < beta) && (value > alpha)) || (value >= MATE) || (value <= -MATE) )))
   
   {
-    lookupTable[onMove][offset].hash = hashValue >> 16;
-
-#ifdef DEBUG_HASH 
-	lookupTable[onMove][offset].hashT = hashValueT >> 16;
-#endif
-
     if((value < beta) && (value > alpha))
 	{
-		lookupTable[onMove][offset].type = EXACT;
+		type = EXACT;
     }
     else if(value >= beta) 
 	{   
-		lookupTable[onMove][offset].type = FAIL_HIGH;
+		type = FAIL_HIGH;
     } 
-	else if(value <= alpha) 
+	else
 	{            
-		lookupTable[onMove][offset].type = FAIL_LOW;
+		type = FAIL_LOW;
     } 
 
 	// mates adjustment
@@ -654,66 +1407,127 @@ assert  (hashMoveCircle <= 7);
 		value += ply;
 	}
 
-	
-	lookupTable[onMove][offset].value = sword (value);
-	lookupTable[onMove][offset].depth = byte (depthSearched);
-	lookupTable[onMove][offset].moveNr = byte (hashMoveCircle);
+	data = packEntry(key, type, hashMoveCircle, depthSearched, value, bestMove);
+	bucket->data[slot] = data;
+	bucket->check[slot] = entryCheck(key, data);
 
-	if(!bestMove.isBad()) 
-	{
-      lookupTable[onMove][offset].hashMove = bestMove;
-    } 
-	else 
-	{
-      lookupTable[onMove][offset].hashMove.makeBad();
-    }	
+#ifdef DEBUG_HASH 
+	bucket->hashT[slot] = (hashValueT ^ hashSideNumbersT[onMove]) >> 16;
+#endif
   }
 	
 
   return;
 }
 
-/* Function: lookup
+/* Function: prefetchHash
  * Input:    None.
- * Output:   The transpositionEntry that corresponds to this position (if any)
- * Purpose:  Used to find if the position was searched before and we "remember"
- *           the result.
+ * Output:   None.
+ * Purpose:  Asks the CPU to load the bucket of this position into the cache,
+ *           so that the lookup() a bit later doesn't have to wait for it.
+ */
+
+void boardStruct::prefetchHash()
+{
+#if defined(_win32_)
+	_mm_prefetch((const char *) &lookupTable[bucketIndex(tableKey())], _MM_HINT_T0);
+#elif defined(__GNUC__)
+	__builtin_prefetch(&lookupTable[bucketIndex(tableKey())]);
+#endif
+}
+
+/* Function: expandMove
+ * Input:    A move as made by move::compact().
+ * Output:   The move, a bad move for 0.
+ * Purpose:  The transposition table keeps moves in 16 bits, without the
+ *           moved piece.  That is taken from the board.
  */
 
-transpositionEntry *boardStruct::lookup()
+move boardStruct::expandMove(word compactMove)
 {
+  move m;
+  square to = compactMove & 63, from = (compactMove >> 6) & 63;
+  piece p = compactMove >> 12;
 
+  if (!compactMove) 
+  {
+	  m.setData(0);
+	  m.makeBad();
+  }
+  else if (p & COMPACT_DROP) 
+  {
+	  m = move(IN_HAND, to, p & 7);
+  }
+  else
+  {
+	  m = move(from, to, position[from], p);
+  }
 
-  duword offset;
-	
-  offset = (duword) (hashValue & lookupMask);
+  return m;
+}
 
-  if ((lookupTable[onMove][offset].hash == hashValue >> 16)) { 
+/* Function: lookup
+ * Input:    Where to put the entry found.
+ * Output:   te if this position is in the transposition table, else NULL
+ * Purpose:  Used to find if the position was searched before and we "remember"
+ *           the result.  Each slot is read only once, so what te gets is
+ *           consistent even if another thread writes the slot meanwhile.
+ *           35 bits of the key are kept, so only very rarely an entry of
+ *           another position matches.  Mostly its hash move then doesn't
+ *           fit this position, such entries are a miss.
+ */
 
-	  
-#ifdef DEBUG_HASH
-	  
-	  if (lookupTable[onMove][offset].hashT != hashValueT >> 16)
-	  { 
-		  debug_allcoll++; 	
-	  }
+transpositionEntry *boardStruct::lookup(transpositionEntry *te)
+{
+  hashBucket *bucket;
+  qword data = 0, position;
+  int i, slot = -1;
+	
+  position = tableKey();
+  bucket = &lookupTable[bucketIndex(position)];
 
-#endif 
-	  
+  for (i = 0; i < HASH_BUCKET_SIZE; i++)
+  {
+	  data = bucket->data[i];
 
-	  if (lookupTable[onMove][offset].moveNr != hashMoveCircle) 
+	  if (entryMatches(data, position) && (bucket->check[i] == entryCheck(position, data))) 
 	  {
-      lookupTable[onMove][offset].moveNr = hashMoveCircle;	
+		  slot = i;
+		  break;
 	  }
+  }
 
+  if (slot < 0) return NULL;
 
-	  assert (lookupTable[onMove][offset].depth >= 0 );
-	  assert (lookupTable[onMove][offset].depth <= 128); 
+  te->hashMove = expandMove(unpackEntry(data, te));
 
+  if (!te->hashMove.isBad() && badMove(te->hashMove))
+  {
+	  stats_hashCollisions++;
+	  return NULL;
+  }
 
-    return &lookupTable[onMove][offset];
+#ifdef DEBUG_HASH
+	  
+  if (bucket->hashT[slot] != (hashValueT ^ hashSideNumbersT[onMove]) >> 16)
+  { 
+	  debug_allcoll++; 	
   }
-  else return NULL;
+
+#endif 
+	  
+  te->hash = hashValue >> 16;
+
+  if (te->moveNr != hashMoveCircle) 
+  {
+	  data = packEntry(position, te->type, hashMoveCircle, te->depth, te->value, te->hashMove);
+	  bucket->data[slot] = data;
+	  bucket->check[slot] = entryCheck(position, data);
+  }
+
+  assert (te->depth <= 128); 
+
+  return te;
 }
 
 /* Function: checkLearnTable
@@ -727,20 +1541,20 @@ transpositionEntry *boardStruct::lookup()
 int boardStruct::checkLearnTable()
 {
 
-  if ((!learning) || (currentRules == BUGHOUSE)) return 0; 
+  if ((!learning) || (currentRules == BUGHOUSE) || (learnTable == NULL)) return 0; 
 
-  duword offset;
+  learnEntry *entry;
 	
-  offset = (duword) (hashValue & learnMask);
+  entry = &learnTable[hashValue & learnMask][onMove];
 
-  if ((learnTable[onMove][offset].hash == hashValue >> 16)) 
+  if ((entry->hash == hashValue >> 16)) 
   { 
 	
-assert (learnTable[onMove][offset].value <= 1000);
-assert (learnTable[onMove][offset].value >= -1000); 
+assert (learnValue(entry) <= 1000);
+assert (learnValue(entry) >= -1000); 
   
 
-  return (learnTable[onMove][offset].value / 10 );
+  return (learnValue(entry) / 10 );
 
   }
   else return 0;
@@ -754,15 +1568,14 @@ assert (learnTable[onMove][offset].value >= -1000);
 
 void boardStruct::saveLearnTable(int pointsWon)
 { 
-  duword offset;
-  unsigned int n; 
+  learnEntry *entry;
 
 #ifdef DEBUG_LEARN  
-  int highestValue = 0; 
-  int numberValue = 0; 
   char buf[MAX_STRING]; 
 #endif
 
+if (learnTable == NULL) return;
+
 
 /* If we won but the opening resulted in a position Sunsetter didn't like at all, 
    or vv. don't store big values. It might have been a win on time or the like. */
@@ -798,10 +1611,11 @@ while (!unplayMove())
   if (getDeepBugColor() != getColorOnMove() )
   {		  
 
-	offset = (duword) (hashValue & learnMask);  
+	entry = &learnTable[hashValue & learnMask][onMove];  
 
-	learnTable[onMove][offset].hash = hashValue >> 16;
-	learnTable[onMove][offset].value = (sword) (learnTable[onMove][offset].value + pointsWon) ;
+	entry->hash = hashValue >> 16;
+	entry->value = (sword) (learnValue(entry) + pointsWon);
+	entry->epoch = learnHeader->epoch;
 
 #ifdef DEBUG_LEARN
 	sprintf (buf, "%d ,",pointsWon);
@@ -815,8 +1629,8 @@ while (!unplayMove())
 	pointsWon -= (pointsWon/(firstBigValue / 2)); 
 
 
-assert (learnTable[onMove][offset].value <= INFINITY);
-assert (learnTable[onMove][offset].value >= -INFINITY);
+assert (entry->value <= INFINITY);
+assert (entry->value >= -INFINITY);
 
   }
 }	
@@ -825,31 +1639,10 @@ assert (learnTable[onMove][offset].value >= -INFINITY);
 output ("<done>\n");  
 #endif
 
-/* Make the values age slowly over time, when they become > 100 */
-
-for(n = 0; n <= learnMask; n++) 
-{
-    
-	if (learnTable[WHITE][n].value || learnTable[BLACK][n].value)
-	{
-	
-	learnTable[WHITE][n].value = (sword)( learnTable[WHITE][n].value - (learnTable[WHITE][n].value / 100)); 
-	learnTable[BLACK][n].value = (sword)( learnTable[BLACK][n].value - (learnTable[BLACK][n].value / 100));
-
-#ifdef DEBUG_LEARN	
-	if (learnTable[WHITE][n].value) numberValue++; 
-	if (learnTable[BLACK][n].value) numberValue++; 
-
-	if (abs(learnTable[WHITE][n].value) > abs(highestValue)) highestValue = learnTable[WHITE][n].value; 
-	if (abs(learnTable[BLACK][n].value) > abs(highestValue)) highestValue = learnTable[BLACK][n].value; 
-#endif
+/* Make the values age slowly over time, when they become > 100.  That 
+   happens when they are used next, see learnValue() */
 
-	}
-}
-#ifdef DEBUG_LEARN
-	sprintf (buf,"Learn: Learned positions: %d \n",numberValue); output (buf); 
-	sprintf (buf,"Learn: Highest value    : %d \n\n",highestValue); output (buf); 
-#endif
+learnHeader->epoch++;
   
   return;
 }
@@ -21,16 +21,60 @@
 
 #define MAX_PIECES 20
 
+#define ATTACK_BITS 5		/* Bits of an attack count in attackBits, no
+							square can be attacked more than 16 times */
+
+#define MAX_ATTACK_CHANGES 12	/* The most changes to the attack counts one
+							move makes, 12 for castling and en passant */
+
 #define MAX_ARG    5		/* The most number of arguments Sunsetter takes in a
 							line */
 
+#define MAX_THREADS 64		/* The most search threads "cores" will start */
+
+/* The transposition table is made of buckets of HASH_BUCKET_SIZE slots,
+   3 slots of 10 bytes make a 32 byte bucket, two to a cache line.  When
+   a new position doesn't fit, the slot with the lowest depth - 
+   HASH_AGE_WEIGHT * age is replaced, age being how many moves ago it was
+   last used. */
+
+#define HASH_BUCKET_SIZE 3
+#define HASH_AGE_WEIGHT 16	/* 4 plies per move of age */
+#define CACHE_LINE 64
+
+/* The table is asked for in huge pages, to save TLB misses.  The bucket 
+   index is computed so that there can't be more than MAX_HASH_BUCKETS 
+   (256 GB).  Tables from MIN_PARALLEL_CLEAR on are cleared by CORES threads. */
+
+#define HUGE_PAGE (2 * 1024 * 1024)
+#define MAX_HASH_BUCKETS qword(0xFFFFFFFF)
+#define MIN_PARALLEL_CLEAR (256 * 1024 * 1024)
+
 /* The transposition table must be >= MIN_HASH_SIZE */
 
-#define MIN_HASH_SIZE (0x10000 * sizeof(transpositionEntry) * 16)
+#define MIN_HASH_SIZE (0xC0000 * sizeof(hashBucket))	/* 24 MB */
+
+/* The default eval cache size, "evalcache <MB>" changes it */
+
+#define EVAL_CACHE_SIZE (1024 * 1024)
+
+/* How many entries the king safety cache has, a power of 2 */
+
+#define KING_SAFETY_CACHE_SIZE 4096
+
+/* How many entries the pawn hash table has, a power of 2 */
+
+#define PAWN_HASH_SIZE 16384
+
+/* How far outside the window lazyEval() has to be to leave out king 
+   safety.  The king safety terms were measured: 1 in 20000 evals is over 
+   400, none over 800. */
+
+#define LAZY_EVAL_MARGIN 400
 
-/* The learn table is 4 MB in size */
+/* A new learn file is 4 MB in size, unless "learn <MB>" asks for more */
 
-#define LEARN_SIZE (0x10000 * sizeof(transpositionEntry) * 4)
+#define LEARN_SIZE (4 * 1024 * 1024)
 
 /* define this to turn on logging */
 